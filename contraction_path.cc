@@ -0,0 +1,222 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: contraction_path.cc
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include<vector>
+#include<string>
+#include<algorithm>
+#include<cstdint>
+#include<cstdio>
+#include<cstdlib>
+
+#include "contraction_path.h"
+
+namespace pdaggerq {
+
+/// the cheapest way found so far to form the intermediate for a subset of the arrays
+struct subset_cost {
+
+    /// total floating-point operations
+    double flops = 0.0;
+
+    /// elements in the largest intermediate
+    double memory = 0.0;
+
+    /// one half of the best split (the other half is the rest of the subset). zero for single arrays
+    uint32_t split = 0;
+
+    /// has a split been found?
+    bool found = false;
+
+};
+
+/// product of the dimensions of a set of labels (given as a bit mask)
+static double label_space(uint64_t labels, const std::vector<double> & dims) {
+    double me = 1.0;
+    for (int i = 0; i < (int)dims.size(); i++) {
+        if ( labels & ((uint64_t)1 << i) ) me *= dims[i];
+    }
+    return me;
+}
+
+/// positions of the arrays in a subset, as nested pairs
+static std::string subset_tree(uint32_t subset, const std::vector<subset_cost> & best) {
+    if ( best[subset].split == 0 ) {
+        int i = 0;
+        while ( !(subset & ((uint32_t)1 << i)) ) i++;
+        return std::to_string(i);
+    }
+    uint32_t left = best[subset].split;
+    return "(" + subset_tree(left, best) + "," + subset_tree(subset ^ left, best) + ")";
+}
+
+/// add the steps that form the intermediate for a subset to a path (children first). returns the node for the subset
+static int add_steps(uint32_t subset, const std::vector<subset_cost> & best, const std::vector<uint64_t> & kept, 
+                     const std::vector<label> & labels, const std::vector<double> & dims, int n_arrays, contraction_path & path) {
+
+    if ( best[subset].split == 0 ) {
+        int i = 0;
+        while ( !(subset & ((uint32_t)1 << i)) ) i++;
+        return i;
+    }
+
+    uint32_t left  = best[subset].split;
+    uint32_t right = subset ^ left;
+
+    contraction_step step;
+    step.left  = add_steps(left, best, kept, labels, dims, n_arrays, path);
+    step.right = add_steps(right, best, kept, labels, dims, n_arrays, path);
+
+    // labels of the result, in order of first appearance in the left and right nodes
+    for (int i = 0; i < (int)labels.size(); i++) {
+        if ( (kept[subset] & ((uint64_t)1 << i)) && (kept[left] & ((uint64_t)1 << i)) ) step.labels.push_back(labels[i]);
+    }
+    for (int i = 0; i < (int)labels.size(); i++) {
+        if ( (kept[subset] & ((uint64_t)1 << i)) && !(kept[left] & ((uint64_t)1 << i)) ) step.labels.push_back(labels[i]);
+    }
+
+    uint64_t involved = kept[left] | kept[right];
+    step.flops  = label_space(involved, dims) * ( involved != kept[subset] ? 2.0 : 1.0 );
+    step.memory = label_space(kept[subset], dims);
+
+    path.steps.push_back(step);
+    return n_arrays + (int)path.steps.size() - 1;
+}
+
+contraction_path optimal_contraction_path(const std::vector<std::vector<label> > & arrays, const std::vector<label> & output, double n_occ, double n_vir) {
+
+    int n_arrays = (int)arrays.size();
+    if ( n_arrays > 20 ) {
+        printf("\n");
+        printf("    error: too many arrays (%i) for optimal_contraction_path\n", n_arrays);
+        printf("\n");
+        exit(1);
+    }
+
+    // distinct labels and their dimensions
+    std::vector<label> labels;
+    for (int i = 0; i < (int)arrays.size(); i++) {
+        for (int j = 0; j < (int)arrays[i].size(); j++) {
+            if ( std::find(labels.begin(), labels.end(), arrays[i][j]) == labels.end() ) {
+                labels.push_back(arrays[i][j]);
+            }
+        }
+    }
+    if ( (int)labels.size() > 64 ) {
+        printf("\n");
+        printf("    error: too many labels (%i) for optimal_contraction_path\n", (int)labels.size());
+        printf("\n");
+        exit(1);
+    }
+    std::vector<double> dims;
+    for (int i = 0; i < (int)labels.size(); i++) {
+        if ( labels[i].is_occ() ) {
+            dims.push_back(n_occ);
+        }else if ( labels[i].is_vir() ) {
+            dims.push_back(n_vir);
+        }else {
+            dims.push_back(n_occ + n_vir);
+        }
+    }
+
+    uint32_t n_subsets = (uint32_t)1 << n_arrays;
+
+    // labels of each array and labels of the output
+    std::vector<uint64_t> array_labels(n_arrays, 0);
+    for (int i = 0; i < n_arrays; i++) {
+        for (int j = 0; j < (int)arrays[i].size(); j++) {
+            int k = (int)(std::find(labels.begin(), labels.end(), arrays[i][j]) - labels.begin());
+            array_labels[i] |= (uint64_t)1 << k;
+        }
+    }
+    uint64_t output_labels = 0;
+    for (int i = 0; i < (int)output.size(); i++) {
+        int k = (int)(std::find(labels.begin(), labels.end(), output[i]) - labels.begin());
+        if ( k < (int)labels.size() ) output_labels |= (uint64_t)1 << k;
+    }
+
+    // labels that each subset's intermediate keeps: those it shares with the other 
+    // arrays or with the output. single arrays keep all of their labels
+    std::vector<uint64_t> inside(n_subsets, 0);
+    for (uint32_t s = 1; s < n_subsets; s++) {
+        int i = 0;
+        while ( !(s & ((uint32_t)1 << i)) ) i++;
+        inside[s] = inside[s & (s - 1)] | array_labels[i];
+    }
+    std::vector<uint64_t> kept(n_subsets, 0);
+    for (uint32_t s = 1; s < n_subsets; s++) {
+        if ( (s & (s - 1)) == 0 ) {
+            kept[s] = inside[s];
+        }else {
+            kept[s] = inside[s] & ( inside[(n_subsets - 1) ^ s] | output_labels );
+        }
+    }
+
+    std::vector<subset_cost> best(n_subsets);
+    for (int i = 0; i < n_arrays; i++) {
+        best[(uint32_t)1 << i].found = true;
+    }
+
+    // subsets in increasing order, so both halves of a split are done before the whole
+    for (uint32_t s = 1; s < n_subsets; s++) {
+
+        if ( (s & (s - 1)) == 0 ) continue;
+
+        // splits that put the lowest array on the left, so each split is seen once
+        uint32_t lowest = s & (~s + 1);
+        for (uint32_t left = (s - 1) & s; left > 0; left = (left - 1) & s) {
+
+            if ( !(left & lowest) ) continue;
+            uint32_t right = s ^ left;
+
+            uint64_t involved = kept[left] | kept[right];
+            double step_flops = label_space(involved, dims) * ( involved != kept[s] ? 2.0 : 1.0 );
+            double flops  = best[left].flops + best[right].flops + step_flops;
+            double memory = std::max(label_space(kept[s], dims), std::max(best[left].memory, best[right].memory));
+
+            bool better = !best[s].found 
+                       || flops < best[s].flops * (1.0 - 1e-12)
+                       || ( flops <= best[s].flops * (1.0 + 1e-12) && memory < best[s].memory );
+            if ( better ) {
+                best[s].flops  = flops;
+                best[s].memory = memory;
+                best[s].split  = left;
+                best[s].found  = true;
+            }
+        }
+    }
+
+    contraction_path path;
+    if ( n_arrays == 0 ) return path;
+
+    uint32_t all = n_subsets - 1;
+    add_steps(all, best, kept, labels, dims, n_arrays, path);
+    path.flops  = best[all].flops;
+    path.memory = best[all].memory;
+    path.tree   = subset_tree(all, best);
+
+    return path;
+}
+
+}
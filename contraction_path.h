@@ -0,0 +1,81 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: contraction_path.h
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef CONTRACTION_PATH_H
+#define CONTRACTION_PATH_H
+
+#include<vector>
+#include<string>
+
+#include "label.h"
+
+namespace pdaggerq {
+
+/// one pairwise contraction in a contraction tree
+struct contraction_step {
+
+    /// the nodes contracted. nodes 0 ... n-1 are the arrays; node n + k is the result of step k
+    int left;
+    int right;
+
+    /// labels of the result
+    std::vector<label> labels;
+
+    /// floating-point operations (a multiply, plus an add if labels are summed, for each 
+    /// combination of the labels involved)
+    double flops;
+
+    /// elements in the result
+    double memory;
+
+};
+
+/// a binary contraction tree for a product of arrays
+struct contraction_path {
+
+    /// contractions, in the order they are carried out
+    std::vector<contraction_step> steps;
+
+    /// total floating-point operations
+    double flops = 0.0;
+
+    /// elements in the largest intermediate
+    double memory = 0.0;
+
+    /// the tree as nested pairs of array positions, e.g., ((0,2),1)
+    std::string tree;
+
+};
+
+/// the order of pairwise contractions of arrays (each given by its labels) that needs the 
+/// fewest floating-point operations (and, among those, the smallest largest intermediate),
+/// keeping the output labels. occupied, virtual, and general labels span n_occ, n_vir, and
+/// n_occ + n_vir orbitals. the search is exhaustive over subsets of the arrays, so it is 
+/// meant for the handful of arrays in a single term
+contraction_path optimal_contraction_path(const std::vector<std::vector<label> > & arrays, const std::vector<label> & output, double n_occ, double n_vir);
+
+}
+
+#endif
@@ -25,12 +25,30 @@
 #ifndef DATA_H
 #define DATA_H
 
+#include<vector>
+#include<string>
+#include<utility>
+
+#include "label.h"
+#include "rational.h"
+
 namespace pdaggerq {
 
 class StringData {
 
   private:
 
+    /// empty lists of labels whose storage is kept for the next amplitudes copied in
+    std::vector<std::vector<label> > spare_labels;
+
+    /// empty the lists in amplitudes, keeping them (and their storage) in spare_labels
+    void keep_storage(std::vector<std::vector<label> > & amplitudes) {
+        for (int i = 0; i < (int)amplitudes.size(); i++) {
+            amplitudes[i].clear();
+            spare_labels.push_back(std::move(amplitudes[i]));
+        }
+        amplitudes.clear();
+    }
 
   public:
 
@@ -41,34 +59,34 @@ class StringData {
     ~StringData(){};
 
     /// factor
-    double factor = 1.0;
+    rational factor = 1;
 
     /// list: labels for fermionic creation / annihilation operators 
     std::vector<std::string> string;
 
     /// list: labels for 1- or 2-index tensor
-    std::vector<std::string> tensor;
+    std::vector<label> tensor;
 
     /// tensor type (FOCK, CORE, TWO_BODY, ERI, D+, D-)
     std::string tensor_type;
 
     /// list: labels u amplitudes
-    std::vector<std::vector<std::string> > u_amplitudes;
+    std::vector<std::vector<label> > u_amplitudes;
 
     /// list: labels t amplitudes
-    std::vector<std::vector<std::string> > t_amplitudes;
+    std::vector<std::vector<label> > t_amplitudes;
 
     /// list: labels left-hand eom-cc amplitudes
-    std::vector<std::vector<std::string> > left_amplitudes;
+    std::vector<std::vector<label> > left_amplitudes;
 
     /// list: labels right-hand amplitudes
-    std::vector<std::vector<std::string> > right_amplitudes;
+    std::vector<std::vector<label> > right_amplitudes;
 
     /// list: labels left-hand amplitudes plus boson
-    std::vector<std::vector<std::string> > m_amplitudes;
+    std::vector<std::vector<label> > m_amplitudes;
 
     /// list: labels right-hand amplitudes plus boson
-    std::vector<std::vector<std::string> > s_amplitudes;
+    std::vector<std::vector<label> > s_amplitudes;
 
     /// should we account for l0 in EOM-CC?
     bool has_l0 = false;
@@ -99,6 +117,45 @@ class StringData {
     /// list: is bosonic operator creator or annihilator?
     std::vector<bool> is_boson_dagger;
 
+    /// list: operator (vertex) that each fermionic creation / annihilation operator came from (connected terms only)
+    std::vector<int> vertex;
+
+    /// append copies of the lists in from to the lists in to, reusing storage kept by clear()
+    void copy_amplitudes(std::vector<std::vector<label> > & to, const std::vector<std::vector<label> > & from) {
+        for (int i = 0; i < (int)from.size(); i++) {
+            if ( spare_labels.empty() ) {
+                to.push_back(from[i]);
+                continue;
+            }
+            to.push_back(std::move(spare_labels.back()));
+            spare_labels.pop_back();
+            to.back().assign(from[i].begin(), from[i].end());
+        }
+    }
+
+    /// reset to default values, keeping any storage already allocated (including 
+    /// that of the lists of labels in each set of amplitudes)
+    void clear() {
+        factor = 1;
+        string.clear();
+        tensor.clear();
+        tensor_type.clear();
+        keep_storage(u_amplitudes);
+        keep_storage(t_amplitudes);
+        keep_storage(left_amplitudes);
+        keep_storage(right_amplitudes);
+        keep_storage(m_amplitudes);
+        keep_storage(s_amplitudes);
+        has_l0 = false;
+        has_r0 = false;
+        has_u0 = false;
+        has_m0 = false;
+        has_s0 = false;
+        has_w0 = false;
+        is_boson_dagger.clear();
+        vertex.clear();
+    }
+
 };
 
 }
@@ -0,0 +1,119 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: label.cc
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include<string>
+#include<unordered_map>
+#include<mutex>
+
+#include "label.h"
+
+namespace pdaggerq {
+
+// OCC: I,J,K,L,M,N
+// VIR: A,B,C,D,E,F
+// GEN: P,Q,R,S,T,U,V,W
+
+static bool label_is_occ(const std::string & idx) {
+    if ( idx.empty() ) return false;
+    if ( idx == "I" || idx == "i") {
+        return true;
+    }else if ( idx == "J" || idx == "j") {
+        return true;
+    }else if ( idx == "K" || idx == "k") {
+        return true;
+    }else if ( idx == "L" || idx == "l") {
+        return true;
+    }else if ( idx == "M" || idx == "m") {
+        return true;
+    }else if ( idx == "N" || idx == "n") {
+        return true;
+    }else if ( idx == "N" || idx == "o") {
+        return true;
+    }else if ( idx.at(0) == 'O' || idx.at(0) == 'o') {
+        return true;
+    }else if ( idx.at(0) == 'I' || idx.at(0) == 'i') {
+        return true;
+    }
+    return false;
+}
+
+static bool label_is_vir(const std::string & idx) {
+    if ( idx.empty() ) return false;
+    if ( idx == "A" || idx == "a") {
+        return true;
+    }else if ( idx == "B" || idx == "b") {
+        return true;
+    }else if ( idx == "C" || idx == "c") {
+        return true;
+    }else if ( idx == "D" || idx == "d") {
+        return true;
+    }else if ( idx == "E" || idx == "e") {
+        return true;
+    }else if ( idx == "F" || idx == "f") {
+        return true;
+    }else if ( idx == "F" || idx == "g") {
+        return true;
+    }else if ( idx.at(0) == 'V' || idx.at(0) == 'v') {
+        return true;
+    }else if ( idx.at(0) == 'A' || idx.at(0) == 'a') {
+        return true;
+    }
+    return false;
+}
+
+const label::entry * label::intern(const std::string & name) {
+
+    // entries are never removed, and elements of an unordered_map
+    // do not move on rehash, so pointers to them remain valid
+    static std::unordered_map<std::string, entry> table;
+    static std::mutex table_lock;
+
+    std::lock_guard<std::mutex> lock(table_lock);
+
+    auto it = table.find(name);
+    if ( it != table.end() ) return &it->second;
+
+    entry & me = table[name];
+    me.name   = name;
+    me.id     = (int)table.size() - 1;
+    me.is_occ = label_is_occ(name);
+    me.is_vir = label_is_vir(name);
+
+    return &me;
+}
+
+label::label() {
+    static const entry * empty = intern("");
+    my_entry = empty;
+}
+
+label::label(const std::string & name) {
+    my_entry = intern(name);
+}
+
+label::label(const char * name) {
+    my_entry = intern(name);
+}
+
+}
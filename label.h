@@ -0,0 +1,129 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: label.h
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef LABEL_H
+#define LABEL_H
+
+#include<string>
+#include<functional>
+
+namespace pdaggerq {
+
+/// an orbital label. each distinct label is stored once in a global table,
+/// so copies and comparisons between labels amount to copying and comparing
+/// a pointer, and the occupied / virtual class is looked up rather than parsed
+class label {
+
+  private:
+
+    /// table entry shared by all copies of a label
+    struct entry {
+
+        /// label as it appears in input / output
+        std::string name;
+
+        /// small integer id (order of first appearance)
+        int id;
+
+        /// does label correspond to occupied orbital?
+        bool is_occ;
+
+        /// does label correspond to virtual orbital?
+        bool is_vir;
+
+    };
+
+    /// find (or create) the table entry for a label
+    static const entry * intern(const std::string & name);
+
+    /// table entry for this label
+    const entry * my_entry;
+
+  public:
+
+    /// constructor (empty label)
+    label();
+
+    /// constructor
+    label(const std::string & name);
+
+    /// constructor
+    label(const char * name);
+
+    /// label as a string
+    const std::string & str() const { return my_entry->name; }
+
+    /// label as a c string
+    const char * c_str() const { return my_entry->name.c_str(); }
+
+    /// number of characters in label
+    size_t length() const { return my_entry->name.length(); }
+
+    /// character in label
+    char at(size_t i) const { return my_entry->name.at(i); }
+
+    /// integer id for label
+    int id() const { return my_entry->id; }
+
+    /// does label correspond to occupied orbital?
+    bool is_occ() const { return my_entry->is_occ; }
+
+    /// does label correspond to virtual orbital?
+    bool is_vir() const { return my_entry->is_vir; }
+
+    /// labels convert to strings at the python boundary
+    operator const std::string & () const { return my_entry->name; }
+
+    /// labels are the same if they share a table entry
+    bool operator==(const label & other) const { return my_entry == other.my_entry; }
+    bool operator!=(const label & other) const { return my_entry != other.my_entry; }
+
+    /// compare against strings without adding them to the table
+    bool operator==(const std::string & other) const { return my_entry->name == other; }
+    bool operator!=(const std::string & other) const { return my_entry->name != other; }
+    bool operator==(const char * other) const { return my_entry->name == other; }
+    bool operator!=(const char * other) const { return my_entry->name != other; }
+
+    /// labels sort alphabetically, so output does not depend on the order of first appearance
+    bool operator<(const label & other) const { return my_entry != other.my_entry && my_entry->name < other.my_entry->name; }
+    bool operator>(const label & other) const { return other < *this; }
+
+};
+
+inline bool operator==(const std::string & a, const label & b) { return b == a; }
+inline bool operator!=(const std::string & a, const label & b) { return b != a; }
+inline bool operator==(const char * a, const label & b) { return b == a; }
+inline bool operator!=(const char * a, const label & b) { return b != a; }
+
+}
+
+namespace std {
+
+template<> struct hash<pdaggerq::label> {
+    size_t operator()(const pdaggerq::label & l) const { return std::hash<int>()(l.id()); }
+};
+
+}
+
+#endif
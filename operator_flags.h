@@ -0,0 +1,122 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: operator_flags.h
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef OPERATOR_FLAGS_H
+#define OPERATOR_FLAGS_H
+
+#include<cstdint>
+#include<cstdio>
+#include<cstdlib>
+
+namespace pdaggerq {
+
+/// one flag (e.g., creator / annihilator) for each operator in a string, packed 
+/// into a single word. strings rarely hold more than 20 operators, so 64 is plenty. 
+/// supports the parts of std::vector<bool> that strings use, plus in-place swaps 
+/// and a bit scan for the first pair of operators that is out of order
+class operator_flags {
+
+  private:
+
+    /// flag i is bit i
+    uint64_t bits;
+
+    /// number of flags
+    int n;
+
+    /// bits 0 ... k-1 set
+    static uint64_t low_bits(int k) {
+        return k >= 64 ? ~(uint64_t)0 : ( ( (uint64_t)1 << k ) - 1 );
+    }
+
+  public:
+
+    /// maximum number of flags
+    static const int capacity = 64;
+
+    /// constructor
+    operator_flags() : bits(0), n(0) {}
+
+    /// number of flags
+    int size() const { return n; }
+
+    /// no flags?
+    bool empty() const { return n == 0; }
+
+    /// remove all flags
+    void clear() { bits = 0; n = 0; }
+
+    /// flag i
+    bool operator[](int i) const { return ( bits >> i ) & 1; }
+
+    /// set flag i
+    void set(int i, bool value) {
+        if ( value ) {
+            bits |=  ( (uint64_t)1 << i );
+        }else {
+            bits &= ~( (uint64_t)1 << i );
+        }
+    }
+
+    /// add a flag to the end
+    void push_back(bool value) {
+        if ( n == capacity ) {
+            printf("\n");
+            printf("    error: too many operators in string (max %i)\n",capacity);
+            printf("\n");
+            exit(1);
+        }
+        set(n, value);
+        n++;
+    }
+
+    /// exchange flags i and i+1
+    void swap_adjacent(int i) {
+        uint64_t pair = ( bits >> i ) & 3;
+        if ( pair == 1 || pair == 2 ) bits ^= ( (uint64_t)3 << i );
+    }
+
+    /// remove flags i and i+1
+    void erase_pair(int i) {
+        bits = ( bits & low_bits(i) ) | ( ( bits >> 2 ) & ~low_bits(i) );
+        n -= 2;
+    }
+
+    /// the first i for which flag i is false and flag i+1 is true (-1 if there is none)
+    int first_inversion() const {
+        if ( n < 2 ) return -1;
+        uint64_t me = ~bits & ( bits >> 1 ) & low_bits(n - 1);
+        if ( me == 0 ) return -1;
+        return __builtin_ctzll(me);
+    }
+
+    bool operator==(const operator_flags & other) const { return n == other.n && bits == other.bits; }
+    bool operator!=(const operator_flags & other) const { return !( *this == other ); }
+
+};
+
+}
+
+#endif
@@ -28,15 +28,19 @@
 #include<string>
 #include<algorithm>
 #include<cstring>
+#include<unordered_map>
 #include <math.h>
 
 #include "pq.h"
+#include "tensor_symmetry.h"
+#include "thread_pool.h"
 
 namespace pdaggerq {
 
 pq::pq(std::string vacuum_type) {
 
   vacuum = vacuum_type;
+  fermi_vacuum = ( vacuum == "FERMI" );
   skip = false;
   data = (std::shared_ptr<StringData>)(new StringData());
 
@@ -45,50 +49,39 @@ pq::pq(std::string vacuum_type) {
 pq::~pq() {
 }
 
-bool pq::is_occ(std::string idx) {
-    if ( idx == "I" || idx == "i") {
-        return true;
-    }else if ( idx == "J" || idx == "j") {
-        return true;
-    }else if ( idx == "K" || idx == "k") {
-        return true;
-    }else if ( idx == "L" || idx == "l") {
-        return true;
-    }else if ( idx == "M" || idx == "m") {
-        return true;
-    }else if ( idx == "N" || idx == "n") {
-        return true;
-    }else if ( idx == "N" || idx == "o") {
-        return true;
-    }else if ( idx.at(0) == 'O' || idx.at(0) == 'o') {
-        return true;
-    }else if ( idx.at(0) == 'I' || idx.at(0) == 'i') {
-        return true;
-    }
-    return false;
+void pq::reset(std::string vacuum_type) {
+
+    vacuum = vacuum_type;
+    fermi_vacuum = ( vacuum == "FERMI" );
+    skip   = false;
+    sign   = 1;
+    simplified = false;
+
+    symbol.clear();
+    is_dagger.clear();
+    is_dagger_fermi.clear();
+    delta1.clear();
+    delta2.clear();
+
+    data->clear();
+
 }
 
-bool pq::is_vir(std::string idx) {
-    if ( idx == "A" || idx == "a") {
-        return true;
-    }else if ( idx == "B" || idx == "b") {
-        return true;
-    }else if ( idx == "C" || idx == "c") {
-        return true;
-    }else if ( idx == "D" || idx == "d") {
-        return true;
-    }else if ( idx == "E" || idx == "e") {
-        return true;
-    }else if ( idx == "F" || idx == "f") {
-        return true;
-    }else if ( idx == "F" || idx == "g") {
-        return true;
-    }else if ( idx.at(0) == 'V' || idx.at(0) == 'v') {
-        return true;
-    }else if ( idx.at(0) == 'A' || idx.at(0) == 'a') {
-        return true;
+std::shared_ptr<pq> pq::new_string() {
+
+    if ( pool != nullptr ) {
+        return pool->get(vacuum);
     }
-    return false;
+    return (std::shared_ptr<pq>)(new pq(vacuum));
+
+}
+
+bool pq::is_occ(label idx) {
+    return idx.is_occ();
+}
+
+bool pq::is_vir(label idx) {
+    return idx.is_vir();
 }
 
 void pq::check_occ_vir() {
@@ -124,6 +117,60 @@ void pq::check_occ_vir() {
 
 }
 
+void pq::check_contractible() {
+
+    if ( skip ) return;
+
+    if ( !fermi_vacuum ) return;
+
+    // a contraction pairs a quasi-annihilator with a quasi-creator to its right.
+    // occupied pairs are i* j, and virtual pairs are a b*. for each class,
+    // a running count of quasi-annihilators minus quasi-creators must never
+    // go negative and must end at zero. this also zeros strings whose
+    // rightmost operator is a quasi-annihilator or whose leftmost is a
+    // quasi-creator, since those vanish against the vacuum
+    int n_occ = 0;
+    int n_vir = 0;
+    for (int i = 0; i < (int)symbol.size(); i++) {
+        int & n = is_dagger[i] == is_dagger_fermi[i] ? n_vir : n_occ;
+        if ( is_dagger_fermi[i] ) {
+            n--;
+        }else {
+            n++;
+        }
+        if ( n < 0 ) {
+            skip = true;
+            return;
+        }
+    }
+    if ( n_occ != 0 || n_vir != 0 ) {
+        skip = true;
+        return;
+    }
+
+    // same for bosons: annihilators must be paired with creators to their right
+    int n_boson = 0;
+    for (int i = 0; i < (int)data->is_boson_dagger.size(); i++) {
+        if ( data->is_boson_dagger[i] ) {
+            n_boson--;
+        }else {
+            n_boson++;
+        }
+        if ( n_boson < 0 ) {
+            skip = true;
+            return;
+        }
+    }
+    if ( n_boson != 0 ) {
+        skip = true;
+        return;
+    }
+
+    // existing delta functions might already zero the string
+    check_occ_vir();
+
+}
+
 void pq::check_spin() {
 
     printf("\n");
@@ -201,15 +248,6 @@ void pq::print() {
 
     if ( skip ) return;
 
-    if ( vacuum == "FERMI" && (int)symbol.size() > 0 ) {
-        // check if stings should be zero or not
-        bool is_dagger_right = is_dagger_fermi[(int)symbol.size() - 1];
-        bool is_dagger_left  = is_dagger_fermi[0];
-        if ( !is_dagger_right || is_dagger_left ) {
-            //return;
-        }
-    }
-
     //for (int i = 0; i < (int)symbol.size(); i++) {
     //    printf("%5i\n",(int)is_dagger_fermi[i]);
     //}
@@ -218,7 +256,7 @@ void pq::print() {
     printf("//     ");
     printf("%c", sign > 0 ? '+' : '-');
     printf(" ");
-    printf("%7.5lf", fabs(data->factor));
+    printf("%7.5lf", fabs(data->factor.value()));
     printf(" ");
     for (int i = 0; i < (int)symbol.size(); i++) {
         printf("%s",symbol[i].c_str());
@@ -526,22 +564,13 @@ std::vector<std::string> pq::get_string() {
 
     if ( skip ) return my_string;
 
-    if ( vacuum == "FERMI" && (int)symbol.size() > 0 ) {
-        // check if stings should be zero or not
-        bool is_dagger_right = is_dagger_fermi[(int)symbol.size() - 1];
-        bool is_dagger_left  = is_dagger_fermi[0];
-        if ( !is_dagger_right || is_dagger_left ) {
-            //return;
-        }
-    }
-
     std::string tmp;
     if ( sign > 0 ) {
         tmp = "+";
     }else {
         tmp = "-";
     }
-    my_string.push_back(tmp + std::to_string(fabs(data->factor)));
+    my_string.push_back(tmp + std::to_string(fabs(data->factor.value())));
 
     for (int i = 0; i < (int)symbol.size(); i++) {
         std::string tmp = symbol[i];
@@ -552,7 +581,7 @@ std::vector<std::string> pq::get_string() {
     }
 
     for (int i = 0; i < (int)delta1.size(); i++) {
-        std::string tmp = "d(" + delta1[i] + "," + delta2[i] + ")";
+        std::string tmp = "d(" + delta1[i].str() + "," + delta2[i].str() + ")";
         my_string.push_back(tmp);
     }
 
@@ -561,25 +590,25 @@ std::vector<std::string> pq::get_string() {
 
         if ( data->tensor_type == "TWO_BODY") {
             std::string tmp = "g("
-                            + data->tensor[0]
+                            + data->tensor[0].str()
                             + ","
-                            + data->tensor[1]
+                            + data->tensor[1].str()
                             + ","
-                            + data->tensor[2]
+                            + data->tensor[2].str()
                             + ","
-                            + data->tensor[3]
+                            + data->tensor[3].str()
                             + ")";
             my_string.push_back(tmp);
         }else {
             // dirac
             std::string tmp = "<"
-                            + data->tensor[0]
+                            + data->tensor[0].str()
                             + ","
-                            + data->tensor[1]
+                            + data->tensor[1].str()
                             + "||"
-                            + data->tensor[2]
+                            + data->tensor[2].str()
                             + ","
-                            + data->tensor[3]
+                            + data->tensor[3].str()
                             + ">";
             my_string.push_back(tmp);
         }
@@ -597,9 +626,9 @@ std::vector<std::string> pq::get_string() {
         }else if ( data->tensor_type == "D-") {
             tmp = "d-(";
         }
-        tmp += data->tensor[0]
+        tmp += data->tensor[0].str()
              + ","
-             + data->tensor[1]
+             + data->tensor[1].str()
              + ")";
         my_string.push_back(tmp);
     }
@@ -614,21 +643,21 @@ std::vector<std::string> pq::get_string() {
                 // l1
                 if ( (int)data->left_amplitudes[i].size() == 2 ) {
                     tmp = "l1("
-                        + data->left_amplitudes[i][0]
+                        + data->left_amplitudes[i][0].str()
                         + ","
-                        + data->left_amplitudes[i][1]
+                        + data->left_amplitudes[i][1].str()
                         + ")";
                 }
                 // l2
                 if ( (int)data->left_amplitudes[i].size() == 4 ) {
                     tmp = "l2("
-                        + data->left_amplitudes[i][0]
+                        + data->left_amplitudes[i][0].str()
                         + ","
-                        + data->left_amplitudes[i][1]
+                        + data->left_amplitudes[i][1].str()
                         + ","
-                        + data->left_amplitudes[i][2]
+                        + data->left_amplitudes[i][2].str()
                         + ","
-                        + data->left_amplitudes[i][3]
+                        + data->left_amplitudes[i][3].str()
                         + ")";
                 }
                 my_string.push_back(tmp);
@@ -648,21 +677,21 @@ std::vector<std::string> pq::get_string() {
                 // r1
                 if ( (int)data->right_amplitudes[i].size() == 2 ) {
                     tmp = "r1("
-                        + data->right_amplitudes[i][0]
+                        + data->right_amplitudes[i][0].str()
                         + ","
-                        + data->right_amplitudes[i][1]
+                        + data->right_amplitudes[i][1].str()
                         + ")";
                 }
                 // r2
                 if ( (int)data->right_amplitudes[i].size() == 4 ) {
                     tmp = "r2("
-                        + data->right_amplitudes[i][0]
+                        + data->right_amplitudes[i][0].str()
                         + ","
-                        + data->right_amplitudes[i][1]
+                        + data->right_amplitudes[i][1].str()
                         + ","
-                        + data->right_amplitudes[i][2]
+                        + data->right_amplitudes[i][2].str()
                         + ","
-                        + data->right_amplitudes[i][3]
+                        + data->right_amplitudes[i][3].str()
                         + ")";
                 }
                 my_string.push_back(tmp);
@@ -682,37 +711,37 @@ std::vector<std::string> pq::get_string() {
                 // t1
                 if ( (int)data->t_amplitudes[i].size() == 2 ) {
                     tmp = "t1("
-                        + data->t_amplitudes[i][0]
+                        + data->t_amplitudes[i][0].str()
                         + ","
-                        + data->t_amplitudes[i][1]
+                        + data->t_amplitudes[i][1].str()
                         + ")";
                 }
                 // t2
                 if ( (int)data->t_amplitudes[i].size() == 4 ) {
                     tmp = "t2("
-                        + data->t_amplitudes[i][0]
+                        + data->t_amplitudes[i][0].str()
                         + ","
-                        + data->t_amplitudes[i][1]
+                        + data->t_amplitudes[i][1].str()
                         + ","
-                        + data->t_amplitudes[i][2]
+                        + data->t_amplitudes[i][2].str()
                         + ","
-                        + data->t_amplitudes[i][3]
+                        + data->t_amplitudes[i][3].str()
                         + ")";
                 }
                 // t3
                 if ( (int)data->t_amplitudes[i].size() == 6 ) {
                     tmp = "t3("
-                        + data->t_amplitudes[i][0]
+                        + data->t_amplitudes[i][0].str()
                         + ","
-                        + data->t_amplitudes[i][1]
+                        + data->t_amplitudes[i][1].str()
                         + ","
-                        + data->t_amplitudes[i][2]
+                        + data->t_amplitudes[i][2].str()
                         + ","
-                        + data->t_amplitudes[i][3]
+                        + data->t_amplitudes[i][3].str()
                         + ","
-                        + data->t_amplitudes[i][4]
+                        + data->t_amplitudes[i][4].str()
                         + ","
-                        + data->t_amplitudes[i][5]
+                        + data->t_amplitudes[i][5].str()
                         + ")";
                 }
                 my_string.push_back(tmp);
@@ -729,21 +758,21 @@ std::vector<std::string> pq::get_string() {
                 // u1
                 if ( (int)data->u_amplitudes[i].size() == 2 ) {
                     tmp = "u1("
-                        + data->u_amplitudes[i][0]
+                        + data->u_amplitudes[i][0].str()
                         + ","
-                        + data->u_amplitudes[i][1]
+                        + data->u_amplitudes[i][1].str()
                         + ")";
                 }
                 // u2
                 if ( (int)data->u_amplitudes[i].size() == 4 ) {
                     tmp = "u2("
-                        + data->u_amplitudes[i][0]
+                        + data->u_amplitudes[i][0].str()
                         + ","
-                        + data->u_amplitudes[i][1]
+                        + data->u_amplitudes[i][1].str()
                         + ","
-                        + data->u_amplitudes[i][2]
+                        + data->u_amplitudes[i][2].str()
                         + ","
-                        + data->u_amplitudes[i][3]
+                        + data->u_amplitudes[i][3].str()
                         + ")";
                 }
                 my_string.push_back(tmp);
@@ -763,21 +792,21 @@ std::vector<std::string> pq::get_string() {
                 // m1
                 if ( (int)data->m_amplitudes[i].size() == 2 ) {
                     tmp = "m1("
-                        + data->m_amplitudes[i][0]
+                        + data->m_amplitudes[i][0].str()
                         + ","
-                        + data->m_amplitudes[i][1]
+                        + data->m_amplitudes[i][1].str()
                         + ")";
                 }
                 // m2
                 if ( (int)data->m_amplitudes[i].size() == 4 ) {
                     tmp = "m2("
-                        + data->m_amplitudes[i][0]
+                        + data->m_amplitudes[i][0].str()
                         + ","
-                        + data->m_amplitudes[i][1]
+                        + data->m_amplitudes[i][1].str()
                         + ","
-                        + data->m_amplitudes[i][2]
+                        + data->m_amplitudes[i][2].str()
                         + ","
-                        + data->m_amplitudes[i][3]
+                        + data->m_amplitudes[i][3].str()
                         + ")";
                 }
                 my_string.push_back(tmp);
@@ -797,21 +826,21 @@ std::vector<std::string> pq::get_string() {
                 // s1
                 if ( (int)data->s_amplitudes[i].size() == 2 ) {
                     tmp = "s1("
-                        + data->s_amplitudes[i][0]
+                        + data->s_amplitudes[i][0].str()
                         + ","
-                        + data->s_amplitudes[i][1]
+                        + data->s_amplitudes[i][1].str()
                         + ")";
                 }
                 // s2
                 if ( (int)data->s_amplitudes[i].size() == 4 ) {
                     tmp = "s2("
-                        + data->s_amplitudes[i][0]
+                        + data->s_amplitudes[i][0].str()
                         + ","
-                        + data->s_amplitudes[i][1]
+                        + data->s_amplitudes[i][1].str()
                         + ","
-                        + data->s_amplitudes[i][2]
+                        + data->s_amplitudes[i][2].str()
                         + ","
-                        + data->s_amplitudes[i][3]
+                        + data->s_amplitudes[i][3].str()
                         + ")";
                 }
                 my_string.push_back(tmp);
@@ -845,30 +874,22 @@ std::vector<std::string> pq::get_string() {
     return my_string;
 }
 
-bool pq::is_normal_order() {
+template <bool fermi> bool pq::is_normal_order() {
 
     // don't bother bringing to normal order if we're going to skip this string
     if (skip) return true;
 
-    // fermions
-    if ( vacuum == "TRUE" ) {
-        for (int i = 0; i < (int)symbol.size()-1; i++) {
-            if ( !is_dagger[i] && is_dagger[i+1] ) {
-                return false;
-            }
+    // fermions (creators / annihilators relative to the true or fermi vacuum)
+    const operator_flags & dagger = fermi ? is_dagger_fermi : is_dagger;
+    int n = (int)symbol.size();
+    for (int i = 0; i < n-1; i++) {
+        // check if stings should be zero or not
+        if ( fermi && ( !dagger[n - 1] || dagger[0] ) ) {
+            skip = true; // added 5/28/21
+            return true;
         }
-    }else {
-        for (int i = 0; i < (int)symbol.size()-1; i++) {
-            // check if stings should be zero or not
-            bool is_dagger_right = is_dagger_fermi[(int)symbol.size() - 1];
-            bool is_dagger_left  = is_dagger_fermi[0];
-            if ( !is_dagger_right || is_dagger_left ) {
-                skip = true; // added 5/28/21
-                return true;
-            }
-            if ( !is_dagger_fermi[i] && is_dagger_fermi[i+1] ) {
-                return false;
-            }
+        if ( !dagger[i] && dagger[i+1] ) {
+            return false;
         }
     }
 
@@ -929,7 +950,7 @@ void pq::alphabetize(std::vector<std::shared_ptr<pq> > &ordered) {
                 int val1 = ordered[i]->symbol[j].c_str()[0];
                 int val2 = ordered[i]->symbol[j+1].c_str()[0];
                 if ( val2 < val1 ) {
-                    std::string dum = ordered[i]->symbol[j];
+                    label dum = ordered[i]->symbol[j];
                     ordered[i]->symbol[j] = ordered[i]->symbol[j+1];
                     ordered[i]->symbol[j+1] = dum;
                     ordered[i]->sign = -ordered[i]->sign;
@@ -951,7 +972,7 @@ void pq::alphabetize(std::vector<std::shared_ptr<pq> > &ordered) {
                 int val1 = ordered[i]->symbol[j].c_str()[0];
                 int val2 = ordered[i]->symbol[j+1].c_str()[0];
                 if ( val2 < val1 ) {
-                    std::string dum = ordered[i]->symbol[j];
+                    label dum = ordered[i]->symbol[j];
                     ordered[i]->symbol[j] = ordered[i]->symbol[j+1];
                     ordered[i]->symbol[j+1] = dum;
                     ordered[i]->sign = -ordered[i]->sign;
@@ -969,7 +990,7 @@ void pq::alphabetize(std::vector<std::shared_ptr<pq> > &ordered) {
             int val1 = ordered[i]->delta1[j].c_str()[0];
             int val2 = ordered[i]->delta2[j].c_str()[0];
             if ( val2 < val1 ) {
-                std::string dum = ordered[i]->delta1[j];
+                label dum = ordered[i]->delta1[j];
                 ordered[i]->delta1[j] = ordered[i]->delta2[j];
                 ordered[i]->delta2[j] = dum;
             }
@@ -988,62 +1009,64 @@ void pq::alphabetize(std::vector<std::shared_ptr<pq> > &ordered) {
 
 void pq::update_bra_labels() {
 
-    if ( vacuum == "FERMI" && symbol.size() != 0 ) return;
+    static const label m_label("m"), n_label("n"), e_label("e"), f_label("f");
+
+    if ( fermi_vacuum && symbol.size() != 0 ) return;
 
     if ( skip ) return;
 
     // t_amplitudes
-    bool find_m = index_in_t_amplitudes("m");
-    bool find_n = index_in_t_amplitudes("n");
-    bool find_e = index_in_t_amplitudes("e");
-    bool find_f = index_in_t_amplitudes("f");
+    bool find_m = index_in_t_amplitudes(m_label);
+    bool find_n = index_in_t_amplitudes(n_label);
+    bool find_e = index_in_t_amplitudes(e_label);
+    bool find_f = index_in_t_amplitudes(f_label);
     
-    for (int i = 0; i < data->t_amplitudes.size(); i++) {
+    for (int i = 0; i < (int)data->t_amplitudes.size(); i++) {
 
         if ( data->t_amplitudes[i].size() != 4 ) continue;
 
         if ( find_m && find_n ) {
             // should appear as "mn"
-            if ( data->t_amplitudes[i][2] == "n" && data->t_amplitudes[i][3] == "m" ) {
-                data->t_amplitudes[i][2] = "m";
-                data->t_amplitudes[i][3] = "n";
+            if ( data->t_amplitudes[i][2] == n_label && data->t_amplitudes[i][3] == m_label ) {
+                data->t_amplitudes[i][2] = m_label;
+                data->t_amplitudes[i][3] = n_label;
                 sign = -sign;
             }
         }else if ( find_m ) {
             // should appear as "-m"
-            if ( data->t_amplitudes[i][2] == "m" ) {
+            if ( data->t_amplitudes[i][2] == m_label ) {
                 data->t_amplitudes[i][2] = data->t_amplitudes[i][3];
-                data->t_amplitudes[i][3] = "m";
+                data->t_amplitudes[i][3] = m_label;
                 sign = -sign;
             }
         }else if ( find_n) {
             // should appear as "-n"
-            if ( data->t_amplitudes[i][2] == "n" ) {
+            if ( data->t_amplitudes[i][2] == n_label ) {
                 data->t_amplitudes[i][2] = data->t_amplitudes[i][3];
-                data->t_amplitudes[i][3] = "n";
+                data->t_amplitudes[i][3] = n_label;
                 sign = -sign;
             }
         }
 
         if ( find_e && find_f ) {
             // should appear as "mn"
-            if ( data->t_amplitudes[i][0] == "f" && data->t_amplitudes[i][1] == "e" ) {
-                data->t_amplitudes[i][0] = "e";
-                data->t_amplitudes[i][1] = "f";
+            if ( data->t_amplitudes[i][0] == f_label && data->t_amplitudes[i][1] == e_label ) {
+                data->t_amplitudes[i][0] = e_label;
+                data->t_amplitudes[i][1] = f_label;
                 sign = -sign;
             }
         }else if ( find_e ) {
             // should appear as "-e"
-            if ( data->t_amplitudes[i][0] == "e" ) {
+            if ( data->t_amplitudes[i][0] == e_label ) {
                 data->t_amplitudes[i][0] = data->t_amplitudes[i][1];
-                data->t_amplitudes[i][1] = "e";
+                data->t_amplitudes[i][1] = e_label;
                 sign = -sign;
             }
         }else if ( find_f) {
             // should appear as "-f"
-            if ( data->t_amplitudes[i][0] == "f" ) {
+            if ( data->t_amplitudes[i][0] == f_label ) {
                 data->t_amplitudes[i][0] = data->t_amplitudes[i][1];
-                data->t_amplitudes[i][1] = "f";
+                data->t_amplitudes[i][1] = f_label;
                 sign = -sign;
             }
         }
@@ -1051,57 +1074,57 @@ void pq::update_bra_labels() {
     }
 
     // u_amplitudes
-    find_m = index_in_u_amplitudes("m");
-    find_n = index_in_u_amplitudes("n");
-    find_e = index_in_u_amplitudes("e");
-    find_f = index_in_u_amplitudes("f");
+    find_m = index_in_u_amplitudes(m_label);
+    find_n = index_in_u_amplitudes(n_label);
+    find_e = index_in_u_amplitudes(e_label);
+    find_f = index_in_u_amplitudes(f_label);
     
-    for (int i = 0; i < data->u_amplitudes.size(); i++) {
+    for (int i = 0; i < (int)data->u_amplitudes.size(); i++) {
 
         if ( data->u_amplitudes[i].size() != 4 ) continue;
 
         if ( find_m && find_n ) {
             // should appear as "mn"
-            if ( data->u_amplitudes[i][2] == "n" && data->u_amplitudes[i][3] == "m" ) {
-                data->u_amplitudes[i][2] = "m";
-                data->u_amplitudes[i][3] = "n";
+            if ( data->u_amplitudes[i][2] == n_label && data->u_amplitudes[i][3] == m_label ) {
+                data->u_amplitudes[i][2] = m_label;
+                data->u_amplitudes[i][3] = n_label;
                 sign = -sign;
             }
         }else if ( find_m ) {
             // should appear as "-m"
-            if ( data->u_amplitudes[i][2] == "m" ) {
+            if ( data->u_amplitudes[i][2] == m_label ) {
                 data->u_amplitudes[i][2] = data->u_amplitudes[i][3];
-                data->u_amplitudes[i][3] = "m";
+                data->u_amplitudes[i][3] = m_label;
                 sign = -sign;
             }
         }else if ( find_n) {
             // should appear as "-n"
-            if ( data->u_amplitudes[i][2] == "n" ) {
+            if ( data->u_amplitudes[i][2] == n_label ) {
                 data->u_amplitudes[i][2] = data->u_amplitudes[i][3];
-                data->u_amplitudes[i][3] = "n";
+                data->u_amplitudes[i][3] = n_label;
                 sign = -sign;
             }
         }
 
         if ( find_e && find_f ) {
             // should appear as "mn"
-            if ( data->u_amplitudes[i][0] == "f" && data->u_amplitudes[i][1] == "e" ) {
-                data->u_amplitudes[i][0] = "e";
-                data->u_amplitudes[i][1] = "f";
+            if ( data->u_amplitudes[i][0] == f_label && data->u_amplitudes[i][1] == e_label ) {
+                data->u_amplitudes[i][0] = e_label;
+                data->u_amplitudes[i][1] = f_label;
                 sign = -sign;
             }
         }else if ( find_e ) {
             // should appear as "-e"
-            if ( data->u_amplitudes[i][0] == "e" ) {
+            if ( data->u_amplitudes[i][0] == e_label ) {
                 data->u_amplitudes[i][0] = data->u_amplitudes[i][1];
-                data->u_amplitudes[i][1] = "e";
+                data->u_amplitudes[i][1] = e_label;
                 sign = -sign;
             }
         }else if ( find_f) {
             // should appear as "-f"
-            if ( data->u_amplitudes[i][0] == "f" ) {
+            if ( data->u_amplitudes[i][0] == f_label ) {
                 data->u_amplitudes[i][0] = data->u_amplitudes[i][1];
-                data->u_amplitudes[i][1] = "f";
+                data->u_amplitudes[i][1] = f_label;
                 sign = -sign;
             }
         }
@@ -1109,57 +1132,57 @@ void pq::update_bra_labels() {
     }
 
     // m_amplitudes
-    find_m = index_in_m_amplitudes("m");
-    find_n = index_in_m_amplitudes("n");
-    find_e = index_in_m_amplitudes("e");
-    find_f = index_in_m_amplitudes("f");
+    find_m = index_in_m_amplitudes(m_label);
+    find_n = index_in_m_amplitudes(n_label);
+    find_e = index_in_m_amplitudes(e_label);
+    find_f = index_in_m_amplitudes(f_label);
     
-    for (int i = 0; i < data->m_amplitudes.size(); i++) {
+    for (int i = 0; i < (int)data->m_amplitudes.size(); i++) {
 
         if ( data->m_amplitudes[i].size() != 4 ) continue;
 
         if ( find_m && find_n ) {
             // should appear as "mn"
-            if ( data->m_amplitudes[i][2] == "n" && data->m_amplitudes[i][3] == "m" ) {
-                data->m_amplitudes[i][2] = "m";
-                data->m_amplitudes[i][3] = "n";
+            if ( data->m_amplitudes[i][2] == n_label && data->m_amplitudes[i][3] == m_label ) {
+                data->m_amplitudes[i][2] = m_label;
+                data->m_amplitudes[i][3] = n_label;
                 sign = -sign;
             }
         }else if ( find_m ) {
             // should appear as "-m"
-            if ( data->m_amplitudes[i][2] == "m" ) {
+            if ( data->m_amplitudes[i][2] == m_label ) {
                 data->m_amplitudes[i][2] = data->m_amplitudes[i][3];
-                data->m_amplitudes[i][3] = "m";
+                data->m_amplitudes[i][3] = m_label;
                 sign = -sign;
             }
         }else if ( find_n) {
             // should appear as "-n"
-            if ( data->m_amplitudes[i][2] == "n" ) {
+            if ( data->m_amplitudes[i][2] == n_label ) {
                 data->m_amplitudes[i][2] = data->m_amplitudes[i][3];
-                data->m_amplitudes[i][3] = "n";
+                data->m_amplitudes[i][3] = n_label;
                 sign = -sign;
             }
         }
 
         if ( find_e && find_f ) {
             // should appear as "mn"
-            if ( data->m_amplitudes[i][0] == "f" && data->m_amplitudes[i][1] == "e" ) {
-                data->m_amplitudes[i][0] = "e";
-                data->m_amplitudes[i][1] = "f";
+            if ( data->m_amplitudes[i][0] == f_label && data->m_amplitudes[i][1] == e_label ) {
+                data->m_amplitudes[i][0] = e_label;
+                data->m_amplitudes[i][1] = f_label;
                 sign = -sign;
             }
         }else if ( find_e ) {
             // should appear as "-e"
-            if ( data->m_amplitudes[i][0] == "e" ) {
+            if ( data->m_amplitudes[i][0] == e_label ) {
                 data->m_amplitudes[i][0] = data->m_amplitudes[i][1];
-                data->m_amplitudes[i][1] = "e";
+                data->m_amplitudes[i][1] = e_label;
                 sign = -sign;
             }
         }else if ( find_f) {
             // should appear as "-f"
-            if ( data->m_amplitudes[i][0] == "f" ) {
+            if ( data->m_amplitudes[i][0] == f_label ) {
                 data->m_amplitudes[i][0] = data->m_amplitudes[i][1];
-                data->m_amplitudes[i][1] = "f";
+                data->m_amplitudes[i][1] = f_label;
                 sign = -sign;
             }
         }
@@ -1167,57 +1190,57 @@ void pq::update_bra_labels() {
     }
 
     // s_amplitudes
-    find_m = index_in_s_amplitudes("m");
-    find_n = index_in_s_amplitudes("n");
-    find_e = index_in_s_amplitudes("e");
-    find_f = index_in_s_amplitudes("f");
+    find_m = index_in_s_amplitudes(m_label);
+    find_n = index_in_s_amplitudes(n_label);
+    find_e = index_in_s_amplitudes(e_label);
+    find_f = index_in_s_amplitudes(f_label);
     
-    for (int i = 0; i < data->s_amplitudes.size(); i++) {
+    for (int i = 0; i < (int)data->s_amplitudes.size(); i++) {
 
         if ( data->s_amplitudes[i].size() != 4 ) continue;
 
         if ( find_m && find_n ) {
             // should appear as "mn"
-            if ( data->s_amplitudes[i][2] == "n" && data->s_amplitudes[i][3] == "m" ) {
-                data->s_amplitudes[i][2] = "m";
-                data->s_amplitudes[i][3] = "n";
+            if ( data->s_amplitudes[i][2] == n_label && data->s_amplitudes[i][3] == m_label ) {
+                data->s_amplitudes[i][2] = m_label;
+                data->s_amplitudes[i][3] = n_label;
                 sign = -sign;
             }
         }else if ( find_m ) {
             // should appear as "-m"
-            if ( data->s_amplitudes[i][2] == "m" ) {
+            if ( data->s_amplitudes[i][2] == m_label ) {
                 data->s_amplitudes[i][2] = data->s_amplitudes[i][3];
-                data->s_amplitudes[i][3] = "m";
+                data->s_amplitudes[i][3] = m_label;
                 sign = -sign;
             }
         }else if ( find_n) {
             // should appear as "-n"
-            if ( data->s_amplitudes[i][2] == "n" ) {
+            if ( data->s_amplitudes[i][2] == n_label ) {
                 data->s_amplitudes[i][2] = data->s_amplitudes[i][3];
-                data->s_amplitudes[i][3] = "n";
+                data->s_amplitudes[i][3] = n_label;
                 sign = -sign;
             }
         }
 
         if ( find_e && find_f ) {
             // should appear as "mn"
-            if ( data->s_amplitudes[i][0] == "f" && data->s_amplitudes[i][1] == "e" ) {
-                data->s_amplitudes[i][0] = "e";
-                data->s_amplitudes[i][1] = "f";
+            if ( data->s_amplitudes[i][0] == f_label && data->s_amplitudes[i][1] == e_label ) {
+                data->s_amplitudes[i][0] = e_label;
+                data->s_amplitudes[i][1] = f_label;
                 sign = -sign;
             }
         }else if ( find_e ) {
             // should appear as "-e"
-            if ( data->s_amplitudes[i][0] == "e" ) {
+            if ( data->s_amplitudes[i][0] == e_label ) {
                 data->s_amplitudes[i][0] = data->s_amplitudes[i][1];
-                data->s_amplitudes[i][1] = "e";
+                data->s_amplitudes[i][1] = e_label;
                 sign = -sign;
             }
         }else if ( find_f) {
             // should appear as "-f"
-            if ( data->s_amplitudes[i][0] == "f" ) {
+            if ( data->s_amplitudes[i][0] == f_label ) {
                 data->s_amplitudes[i][0] = data->s_amplitudes[i][1];
-                data->s_amplitudes[i][1] = "f";
+                data->s_amplitudes[i][1] = f_label;
                 sign = -sign;
             }
         }
@@ -1227,53 +1250,53 @@ void pq::update_bra_labels() {
     // tensor
     if ( data->tensor.size() != 4 ) return;
 
-    find_m = index_in_tensor("m");
-    find_n = index_in_tensor("n");
-    find_e = index_in_tensor("e");
-    find_f = index_in_tensor("f");
+    find_m = index_in_tensor(m_label);
+    find_n = index_in_tensor(n_label);
+    find_e = index_in_tensor(e_label);
+    find_f = index_in_tensor(f_label);
     
     if ( find_m && find_n ) {
         // should appear as "mn"
-        if ( data->tensor[2] == "n" && data->tensor[3] == "m" ) {
-            data->tensor[2] = "m";
-            data->tensor[3] = "n";
+        if ( data->tensor[2] == n_label && data->tensor[3] == m_label ) {
+            data->tensor[2] = m_label;
+            data->tensor[3] = n_label;
             sign = -sign;
         }
     }else if ( find_m ) {
         // should appear as "-m"
-        if ( data->tensor[2] == "m" ) {
+        if ( data->tensor[2] == m_label ) {
             data->tensor[2] = data->tensor[3];
-            data->tensor[3] = "m";
+            data->tensor[3] = m_label;
             sign = -sign;
         }
     }else if ( find_n) {
         // should appear as "-n"
-        if ( data->tensor[2] == "n" ) {
+        if ( data->tensor[2] == n_label ) {
             data->tensor[2] = data->tensor[3];
-            data->tensor[3] = "n";
+            data->tensor[3] = n_label;
             sign = -sign;
         }
     }
 
     if ( find_e && find_f ) {
         // should appear as "mn"
-        if ( data->tensor[0] == "f" && data->tensor[1] == "e" ) {
-            data->tensor[0] = "e";
-            data->tensor[1] = "f";
+        if ( data->tensor[0] == f_label && data->tensor[1] == e_label ) {
+            data->tensor[0] = e_label;
+            data->tensor[1] = f_label;
             sign = -sign;
         }
     }else if ( find_e ) {
         // should appear as "-e"
-        if ( data->tensor[0] == "e" ) {
+        if ( data->tensor[0] == e_label ) {
             data->tensor[0] = data->tensor[1];
-            data->tensor[1] = "e";
+            data->tensor[1] = e_label;
             sign = -sign;
         }
     }else if ( find_f) {
         // should appear as "-f"
-        if ( data->tensor[0] == "f" ) {
+        if ( data->tensor[0] == f_label ) {
             data->tensor[0] = data->tensor[1];
-            data->tensor[1] = "f";
+            data->tensor[1] = f_label;
             sign = -sign;
         }
     }
@@ -1285,191 +1308,194 @@ void pq::update_bra_labels() {
 // already present.
 void pq::update_summation_labels() {
 
-    if ( vacuum == "FERMI" && symbol.size() != 0 ) return;
+    static const label i_label("i"), j_label("j"), k_label("k"), l_label("l");
+    static const label a_label("a"), b_label("b"), c_label("c"), d_label("d");
+
+    if ( fermi_vacuum && symbol.size() != 0 ) return;
 
     if ( skip ) return;
 
-    bool find_i = index_in_anywhere("i");
-    bool find_j = index_in_anywhere("j");
-    bool find_k = index_in_anywhere("k");
-    bool find_l = index_in_anywhere("l");
+    bool find_i = index_in_anywhere(i_label);
+    bool find_j = index_in_anywhere(j_label);
+    bool find_k = index_in_anywhere(k_label);
+    bool find_l = index_in_anywhere(l_label);
 
-    bool find_a = index_in_anywhere("a");
-    bool find_b = index_in_anywhere("b");
-    bool find_c = index_in_anywhere("c");
-    bool find_d = index_in_anywhere("d");
+    bool find_a = index_in_anywhere(a_label);
+    bool find_b = index_in_anywhere(b_label);
+    bool find_c = index_in_anywhere(c_label);
+    bool find_d = index_in_anywhere(d_label);
 
     // i,j,k,l
     if ( !find_i && find_j && find_k && find_l ) {
 
-        replace_index_everywhere("l","i");
+        replace_index_everywhere(l_label,i_label);
 
     }else if ( !find_i && find_j && find_k && !find_l ) {
 
-        replace_index_everywhere("k","i");
+        replace_index_everywhere(k_label,i_label);
 
     }else if ( !find_i && find_j && !find_k && !find_l ) {
 
-        replace_index_everywhere("j","i");
+        replace_index_everywhere(j_label,i_label);
 
     }else if ( !find_i && find_j && !find_k && find_l ) {
 
-        replace_index_everywhere("l","i");
+        replace_index_everywhere(l_label,i_label);
 
     }else if ( !find_i && !find_j && find_k && find_l ) {
 
-        replace_index_everywhere("k","i");
-        replace_index_everywhere("l","j");
+        replace_index_everywhere(k_label,i_label);
+        replace_index_everywhere(l_label,j_label);
 
     }else if ( !find_i && !find_j && !find_k && find_l ) {
 
-        replace_index_everywhere("l","i");
+        replace_index_everywhere(l_label,i_label);
 
     }else if ( !find_i && !find_j && find_k && !find_l ) {
 
-        replace_index_everywhere("k","i");
+        replace_index_everywhere(k_label,i_label);
 
     }else if ( find_i && !find_j && find_k && find_l ) {
 
-        replace_index_everywhere("l","j");
+        replace_index_everywhere(l_label,j_label);
 
     }else if ( find_i && !find_j && !find_k && find_l ) {
 
-        replace_index_everywhere("l","j");
+        replace_index_everywhere(l_label,j_label);
 
     }else if ( find_i && !find_j && find_k && !find_l ) {
 
-        replace_index_everywhere("k","j");
+        replace_index_everywhere(k_label,j_label);
 
     }else if ( find_i && !find_j && !find_k && find_l ) {
 
-        replace_index_everywhere("l","j");
+        replace_index_everywhere(l_label,j_label);
 
     }
 
     // a,b,c,d
     if ( !find_a && find_b && find_c && find_d ) {
 
-        replace_index_everywhere("d","a");
+        replace_index_everywhere(d_label,a_label);
 
     }else if ( !find_a && find_b && find_c && !find_d ) {
 
-        replace_index_everywhere("c","a");
+        replace_index_everywhere(c_label,a_label);
 
     }else if ( !find_a && find_b && !find_c && find_d ) {
 
-        replace_index_everywhere("d","a");
+        replace_index_everywhere(d_label,a_label);
 
     }else if ( !find_a && find_b && !find_c && !find_d ) {
 
-        replace_index_everywhere("b","a");
+        replace_index_everywhere(b_label,a_label);
 
     }else if ( !find_a && !find_b && find_c && find_d ) {
 
-        replace_index_everywhere("c","a");
-        replace_index_everywhere("d","b");
+        replace_index_everywhere(c_label,a_label);
+        replace_index_everywhere(d_label,b_label);
 
     }else if ( !find_a && !find_b && !find_c && find_d ) {
 
-        replace_index_everywhere("d","a");
+        replace_index_everywhere(d_label,a_label);
 
     }else if ( !find_a && !find_b && find_c && !find_d ) {
 
-        replace_index_everywhere("c","a");
+        replace_index_everywhere(c_label,a_label);
 
     }else if ( find_a && !find_b && find_c && find_d ) {
 
-        replace_index_everywhere("d","b");
+        replace_index_everywhere(d_label,b_label);
 
     }else if ( find_a && !find_b && !find_c && find_d ) {
 
-        replace_index_everywhere("d","b");
+        replace_index_everywhere(d_label,b_label);
 
     }else if ( find_a && !find_b && !find_c && find_d ) {
 
-        replace_index_everywhere("d","b");
+        replace_index_everywhere(d_label,b_label);
 
     }else if ( find_a && !find_b && find_c && !find_d ) {
 
-        replace_index_everywhere("c","b");
+        replace_index_everywhere(c_label,b_label);
 
     }else if ( find_a && !find_b && !find_c && find_d ) {
 
-        replace_index_everywhere("d","b");
+        replace_index_everywhere(d_label,b_label);
 
     }
 
     // now, if tensors appear as <ji||xx>, swap to -<ij|xx>, <ai||xx> = -<ia|xx>, ec.
 
     if ( data->tensor.size() == 4 ) {
-        if ( data->tensor[0] == "j" && data->tensor[1] == "i" ) {
-            data->tensor[0] = "i";
-            data->tensor[1] = "j";
+        if ( data->tensor[0] == j_label && data->tensor[1] == i_label ) {
+            data->tensor[0] = i_label;
+            data->tensor[1] = j_label;
             sign = -sign;
         }
-        if ( data->tensor[2] == "j" && data->tensor[3] == "i" ) {
-            data->tensor[2] = "i";
-            data->tensor[3] = "j";
+        if ( data->tensor[2] == j_label && data->tensor[3] == i_label ) {
+            data->tensor[2] = i_label;
+            data->tensor[3] = j_label;
             sign = -sign;
         }
 
 
-        if ( data->tensor[0] == "b" && data->tensor[1] == "a" ) {
-            data->tensor[0] = "a";
-            data->tensor[1] = "b";
+        if ( data->tensor[0] == b_label && data->tensor[1] == a_label ) {
+            data->tensor[0] = a_label;
+            data->tensor[1] = b_label;
             sign = -sign;
         }
-        if ( data->tensor[2] == "b" && data->tensor[3] == "a" ) {
-            data->tensor[2] = "a";
-            data->tensor[3] = "b";
+        if ( data->tensor[2] == b_label && data->tensor[3] == a_label ) {
+            data->tensor[2] = a_label;
+            data->tensor[3] = b_label;
             sign = -sign;
         }
 
 
-        if ( data->tensor[0] == "a" && data->tensor[1] == "i" ) {
-            data->tensor[0] = "i";
-            data->tensor[1] = "a";
+        if ( data->tensor[0] == a_label && data->tensor[1] == i_label ) {
+            data->tensor[0] = i_label;
+            data->tensor[1] = a_label;
             sign = -sign;
         }
-        if ( data->tensor[2] == "a" && data->tensor[3] == "i" ) {
-            data->tensor[2] = "i";
-            data->tensor[3] = "a";
+        if ( data->tensor[2] == a_label && data->tensor[3] == i_label ) {
+            data->tensor[2] = i_label;
+            data->tensor[3] = a_label;
             sign = -sign;
         }
 
 
-        if ( data->tensor[0] == "b" && data->tensor[1] == "i" ) {
-            data->tensor[0] = "i";
-            data->tensor[1] = "b";
+        if ( data->tensor[0] == b_label && data->tensor[1] == i_label ) {
+            data->tensor[0] = i_label;
+            data->tensor[1] = b_label;
             sign = -sign;
         }
-        if ( data->tensor[2] == "b" && data->tensor[3] == "i" ) {
-            data->tensor[2] = "i";
-            data->tensor[3] = "b";
+        if ( data->tensor[2] == b_label && data->tensor[3] == i_label ) {
+            data->tensor[2] = i_label;
+            data->tensor[3] = b_label;
             sign = -sign;
         }
 
 
-        if ( data->tensor[0] == "a" && data->tensor[1] == "j" ) {
-            data->tensor[0] = "j";
-            data->tensor[1] = "a";
+        if ( data->tensor[0] == a_label && data->tensor[1] == j_label ) {
+            data->tensor[0] = j_label;
+            data->tensor[1] = a_label;
             sign = -sign;
         }
-        if ( data->tensor[2] == "a" && data->tensor[3] == "j" ) {
-            data->tensor[2] = "j";
-            data->tensor[3] = "a";
+        if ( data->tensor[2] == a_label && data->tensor[3] == j_label ) {
+            data->tensor[2] = j_label;
+            data->tensor[3] = a_label;
             sign = -sign;
         }
 
 
-        if ( data->tensor[0] == "b" && data->tensor[1] == "j" ) {
-            data->tensor[0] = "j";
-            data->tensor[1] = "b";
+        if ( data->tensor[0] == b_label && data->tensor[1] == j_label ) {
+            data->tensor[0] = j_label;
+            data->tensor[1] = b_label;
             sign = -sign;
         }
-        if ( data->tensor[2] == "b" && data->tensor[3] == "j" ) {
-            data->tensor[2] = "j";
-            data->tensor[3] = "b";
+        if ( data->tensor[2] == b_label && data->tensor[3] == j_label ) {
+            data->tensor[2] = j_label;
+            data->tensor[3] = b_label;
             sign = -sign;
         }
     }
@@ -1479,12 +1505,12 @@ void pq::update_summation_labels() {
     // if labels are repeated in a four-index tensor, then they should be paired: <ij||jm> -> -<ij|mj>
     if ( data->tensor.size() == 4 ) {
         if ( data->tensor[0] == data->tensor[3] ) {
-            std::string tmp = data->tensor[3];
+            label tmp = data->tensor[3];
             data->tensor[3] = data->tensor[2];
             data->tensor[2] = tmp;
             sign = -sign;
         }else if ( data->tensor[1] == data->tensor[2] ) {
-            std::string tmp = data->tensor[2];
+            label tmp = data->tensor[2];
             data->tensor[2] = data->tensor[3];
             data->tensor[3] = tmp;
             sign = -sign;
@@ -1494,11 +1520,13 @@ void pq::update_summation_labels() {
 
 }
 
-void pq::swap_two_labels(std::string label1, std::string label2) {
+void pq::swap_two_labels(label label1, label label2) {
+
+    static const label x_label("x");
 
-    replace_index_everywhere(label1,"x");
+    replace_index_everywhere(label1,x_label);
     replace_index_everywhere(label2,label1);
-    replace_index_everywhere("x",label2);
+    replace_index_everywhere(x_label,label2);
 }
 
 void pq::reorder_t_amplitudes() {
@@ -1510,7 +1538,7 @@ void pq::reorder_t_amplitudes() {
     bool* nope = (bool*)malloc(dim * sizeof(bool));
     memset((void*)nope,'\0',dim * sizeof(bool));
 
-    std::vector<std::vector<std::string> > tmp;
+    std::vector<std::vector<label> > tmp;
     // t1 first
     for (int i = 0; i < dim; i++) {
         for (int j = 0; j < dim; j++) {
@@ -1575,21 +1603,22 @@ void pq::reorder_t_amplitudes() {
 // TODO: need to consider u-amplitudes
 // TODO: need to consider left-hand amplitudes
 // TODO: need to consider right-hand amplitudes
-void pq::cleanup(std::vector<std::shared_ptr<pq> > &ordered) {
+long int pq::cleanup(std::vector<std::shared_ptr<pq> > &ordered, bool use_canonical_labels, bool real_orbitals, thread_pool * threads) {
 
-    // order amplitudes such that they're ordered t1, t2, t3
-    for (int i = 0; i < (int)ordered.size(); i++) {
+    static const label i_label("i"), j_label("j"), a_label("a"), b_label("b");
+
+    parallel_for(threads, (int)ordered.size(), [&](int i) {
+
+        // order amplitudes such that they're ordered t1, t2, t3
         ordered[i]->reorder_t_amplitudes();
-    }
 
-    // prioritize summation labels as i > j > k > l and a > b > c > d.
-    // this means that j, k, or l should not arise in a term if i is not
-    // already present. only do this for vacuum_type = "FERMI"
-    for (int i = 0; i < (int)ordered.size(); i++) {
-        if ( vacuum != "FERMI" ) continue;
+        // prioritize summation labels as i > j > k > l and a > b > c > d.
+        // this means that j, k, or l should not arise in a term if i is not
+        // already present. only do this for vacuum_type = "FERMI"
+        if ( !fermi_vacuum || use_canonical_labels ) return;
         ordered[i]->update_summation_labels();
         //ordered[i]->update_bra_labels();
-    }
+    });
 
     // prune list so it only contains non-skipped ones
     std::vector< std::shared_ptr<pq> > pruned;
@@ -1600,7 +1629,7 @@ void pq::cleanup(std::vector<std::shared_ptr<pq> > &ordered) {
         // for normal order relative to fermi vacuum, i doubt anyone will care 
         // about terms that aren't fully contracted. so, skip those because this
         // function is time consuming
-        if ( vacuum == "FERMI" ) {
+        if ( fermi_vacuum ) {
             if ( ordered[i]->symbol.size() != 0 ) continue;
             if ( ordered[i]->data->is_boson_dagger.size() != 0 ) continue;
         }
@@ -1615,116 +1644,225 @@ void pq::cleanup(std::vector<std::shared_ptr<pq> > &ordered) {
 
     //printf("starting string comparisons\n");fflush(stdout);
 
-    // consolidate terms, including those that differ only by symmetric quantities [i.e., g(iajb) and g(jbia)]
-    for (int i = 0; i < (int)ordered.size(); i++) {
-
-        if ( ordered[i]-> skip ) continue;
+    // equivalent strings have identical canonical forms, so they can be merged in a single pass
+    if ( fermi_vacuum && use_canonical_labels ) {
+        std::vector< std::shared_ptr<pq> > merged;
+        std::unordered_map<std::string, int> index;
+        merge_canonical(ordered, merged, index, real_orbitals, threads);
+        ordered.swap(merged);
+        return 0;
+    }
 
-        // TODO: should be searching for labels in left / right / m / s amplitudes as well
+    // consolidate terms, including those that differ only by symmetric quantities [i.e., g(iajb) and g(jbia)]
 
-        bool find_i = ordered[i]->index_in_tensor("i") 
-                   || ordered[i]->index_in_t_amplitudes("i") 
-                   || ordered[i]->index_in_u_amplitudes("i");
+    // rather than comparing every pair of strings, only compare strings that 
+    // share a comparison key. the key is the same for any two strings that 
+    // compare_strings could consider the same, so each string is compared to 
+    // the few earlier ones in its bucket, and the results are identical to an 
+    // all-pairs comparison.
 
-        bool find_j = ordered[i]->index_in_tensor("j") 
-                   || ordered[i]->index_in_t_amplitudes("j") 
-                   || ordered[i]->index_in_u_amplitudes("j");
-                                                                                                                                             
-        bool find_a = ordered[i]->index_in_tensor("a") 
-                   || ordered[i]->index_in_t_amplitudes("a") 
-                   || ordered[i]->index_in_u_amplitudes("a");
+    // strings in different buckets are never merged, so buckets are split 
+    // into shards that are processed independently (on several threads, if 
+    // available). each shard visits its strings in their original order, so 
+    // the results do not depend on the number of shards.
 
-        bool find_b = ordered[i]->index_in_tensor("b") 
-                   || ordered[i]->index_in_t_amplitudes("b") 
-                   || ordered[i]->index_in_u_amplitudes("b");
+    std::vector<std::string> keys(ordered.size());
+    parallel_for(threads, (int)ordered.size(), [&](int j) {
+        keys[j] = ordered[j]->comparison_key();
+    });
 
-        for (int j = i+1; j < (int)ordered.size(); j++) {
+    int n_shards = threads == nullptr ? 1 : 8 * threads->size();
+    std::vector< std::vector<int> > shards(n_shards);
+    std::hash<std::string> hash;
+    for (int j = 0; j < (int)ordered.size(); j++) {
+        shards[hash(keys[j]) % n_shards].push_back(j);
+    }
 
-            if ( ordered[i]-> skip ) continue;
+    // copies of strings with i/j, a/b, and i/j+a/b swapped
+    std::vector< std::vector< std::shared_ptr<pq> > > swapped(ordered.size());
 
-            int n_permute;
-            bool strings_same = compare_strings(ordered[i],ordered[j],n_permute);
+    // number of calls to compare_strings in each shard
+    std::vector<long int> n_compare(n_shards, 0);
 
-/*
-            bool find_i = ordered[j]->index_in_tensor("i") || ordered[j]->index_in_t_amplitudes("i") || ordered[j]->index_in_u_amplitudes("i");
-            bool find_j = ordered[j]->index_in_tensor("j") || ordered[j]->index_in_t_amplitudes("j") || ordered[j]->index_in_u_amplitudes("j");
-                                                                                                                                                 
-            bool find_a = ordered[j]->index_in_tensor("a") || ordered[j]->index_in_t_amplitudes("a") || ordered[j]->index_in_u_amplitudes("a");
-            bool find_b = ordered[j]->index_in_tensor("b") || ordered[j]->index_in_t_amplitudes("b") || ordered[j]->index_in_u_amplitudes("b");
-*/
+    parallel_for(threads, n_shards, [&](int s) {
 
-            // try swapping summation labels - only i/j, a/b swaps for now. this should be sufficient for ccsd
-            if ( !strings_same && find_i && find_j ) {
+        // earlier strings in this shard that haven't been folded into another one, grouped by key
+        std::unordered_map<std::string, std::vector<int> > buckets;
 
-                std::shared_ptr<pq> newguy (new pq(vacuum));
-                newguy->copy((void*)(ordered[i].get()));
-                newguy->swap_two_labels("i","j");
-                strings_same = compare_strings(ordered[j],newguy,n_permute);
-            }
+        for (int jj = 0; jj < (int)shards[s].size(); jj++) {
 
-            if ( !strings_same && find_a && find_b ) {
+            int j = shards[s][jj];
 
-                std::shared_ptr<pq> newguy (new pq(vacuum));
-                newguy->copy((void*)(ordered[i].get()));
-                newguy->swap_two_labels("a","b");
-                strings_same = compare_strings(ordered[j],newguy,n_permute);
+            std::vector<int> & bucket = buckets[keys[j]];
 
-            }
+            bool found = false;
+            for (int b = 0; b < (int)bucket.size(); b++) {
 
-            if ( !strings_same && find_i && find_j && find_a && find_b ) {
+                int i = bucket[b];
 
-                std::shared_ptr<pq> newguy (new pq(vacuum));
-                newguy->copy((void*)(ordered[i].get()));
-                newguy->swap_two_labels("i","j");
-                newguy->swap_two_labels("a","b");
-                strings_same = compare_strings(ordered[j],newguy,n_permute);
-            }
+                int n_permute;
+                bool strings_same = compare_strings(ordered[i],ordered[j],n_permute);
+                n_compare[s]++;
 
-            if ( !strings_same ) continue;
+                // try swapping summation labels - only i/j, a/b swaps for now. this should be sufficient for ccsd
+                for (int k = 0; k < (int)swapped[i].size(); k++) {
+                    if ( strings_same ) break;
+                    strings_same = compare_strings(ordered[j],swapped[i][k],n_permute);
+                    n_compare[s]++;
+                }
 
-            //printf("same tensors\n");
+                if ( !strings_same ) continue;
 
-            // are factors same?
-            //if ( ordered[i]->data->factor != ordered[j]->data->factor ) continue;
+                found = true;
 
-            // are signs same?
-            //if ( ordered[i]->sign != ordered[j]->sign ) continue;
+                rational factor_i = ordered[i]->data->factor * ordered[i]->sign;
+                rational factor_j = ordered[j]->data->factor * ordered[j]->sign;
 
-            double factor_i = ordered[i]->data->factor * ordered[i]->sign;
-            double factor_j = ordered[j]->data->factor * ordered[j]->sign;
+                rational combined_factor = factor_i + factor_j * ( n_permute % 2 == 0 ? 1 : -1 );
 
-            double combined_factor = factor_i + factor_j * pow(-1.0,n_permute);
+                // if terms exactly cancel, do so
+                if ( combined_factor.sign() == 0 ) {
+                    ordered[i]->skip = true;
+                    ordered[j]->skip = true;
+                    bucket.erase(bucket.begin() + b);
+                    break;
+                }
 
-            // if terms exactly cancel, do so
-            if ( fabs(combined_factor) < 1e-12 ) {
-                //printf("skipping\n");
-                ordered[i]->skip = true;
+                // otherwise, combine terms
+                ordered[i]->data->factor = combined_factor.abs();
+                if ( combined_factor.sign() > 0 ) {
+                    ordered[i]->sign =  1;
+                }else {
+                    ordered[i]->sign = -1;
+                }
                 ordered[j]->skip = true;
                 break;
             }
 
-            // otherwise, combine terms
+            if ( found ) continue;
 
-            //printf("combining\n");
-            // well, i guess the are the same term
-            ordered[i]->data->factor = fabs(combined_factor);
-            if ( combined_factor > 0.0 ) {
-                ordered[i]->sign =  1;
-            }else {
-                ordered[i]->sign = -1;
+            // string j is new, so later strings may be folded into it
+
+            // TODO: should be searching for labels in left / right / m / s amplitudes as well
+
+            bool find_i = ordered[j]->index_in_tensor(i_label) 
+                       || ordered[j]->index_in_t_amplitudes(i_label) 
+                       || ordered[j]->index_in_u_amplitudes(i_label);
+
+            bool find_j = ordered[j]->index_in_tensor(j_label) 
+                       || ordered[j]->index_in_t_amplitudes(j_label) 
+                       || ordered[j]->index_in_u_amplitudes(j_label);
+                                                                                                                                         
+            bool find_a = ordered[j]->index_in_tensor(a_label) 
+                       || ordered[j]->index_in_t_amplitudes(a_label) 
+                       || ordered[j]->index_in_u_amplitudes(a_label);
+
+            bool find_b = ordered[j]->index_in_tensor(b_label) 
+                       || ordered[j]->index_in_t_amplitudes(b_label) 
+                       || ordered[j]->index_in_u_amplitudes(b_label);
+
+            if ( find_i && find_j ) {
+                std::shared_ptr<pq> newguy = new_string();
+                newguy->copy((void*)(ordered[j].get()));
+                newguy->swap_two_labels(i_label,j_label);
+                swapped[j].push_back(newguy);
+            }
+            if ( find_a && find_b ) {
+                std::shared_ptr<pq> newguy = new_string();
+                newguy->copy((void*)(ordered[j].get()));
+                newguy->swap_two_labels(a_label,b_label);
+                swapped[j].push_back(newguy);
+            }
+            if ( find_i && find_j && find_a && find_b ) {
+                std::shared_ptr<pq> newguy = new_string();
+                newguy->copy((void*)(ordered[j].get()));
+                newguy->swap_two_labels(i_label,j_label);
+                newguy->swap_two_labels(a_label,b_label);
+                swapped[j].push_back(newguy);
             }
-            ordered[j]->skip = true;
 
-            // break j because i'm not yet sure the best way to combine multiple terms.
-            //break;
-            
+            bucket.push_back(j);
         }
 
-    }
+    });
 
     // TODO: consolidate terms that differ by permutations of bra labels
     // TODO: consolidate terms that differ by permutations of ket labels
 
+    long int total = 0;
+    for (int s = 0; s < n_shards; s++) {
+        total += n_compare[s];
+    }
+    return total;
+}
+
+void pq::merge_canonical(std::vector<std::shared_ptr<pq> > &in, std::vector<std::shared_ptr<pq> > &merged, 
+                         std::unordered_map<std::string, int> &index, bool real_orbitals, thread_pool * threads) {
+
+    // only fully-contracted strings are kept
+    auto keep = [&](const std::shared_ptr<pq> & me) {
+        if ( me->skip ) return false;
+        if ( me->symbol.size() != 0 ) return false;
+        if ( me->data->is_boson_dagger.size() != 0 ) return false;
+        return true;
+    };
+
+    // the search for each canonical form is independent of the others
+    std::vector<std::string> keys(in.size());
+    parallel_for(threads, (int)in.size(), [&](int j) {
+        if ( !keep(in[j]) ) return;
+        in[j]->reorder_t_amplitudes();
+        keys[j] = in[j]->canonicalize(real_orbitals);
+    });
+
+    for (int j = 0; j < (int)in.size(); j++) {
+
+        // (canonicalize may find that the string vanishes)
+        if ( !keep(in[j]) ) continue;
+
+        auto it = index.find(keys[j]);
+        if ( it == index.end() ) {
+            index[keys[j]] = (int)merged.size();
+            merged.push_back(in[j]);
+            continue;
+        }
+
+        std::shared_ptr<pq> & first = merged[it->second];
+
+        rational combined_factor = first->data->factor * first->sign 
+                                 + in[j]->data->factor * in[j]->sign;
+
+        // if terms exactly cancel, do so
+        if ( combined_factor.sign() == 0 ) {
+            first->skip = true;
+            index.erase(it);
+            continue;
+        }
+
+        // otherwise, combine terms
+        first->data->factor = combined_factor.abs();
+        first->sign = combined_factor.sign();
+    }
+    in.clear();
+
+    // drop cancelled strings once they make up most of the list
+    int n_skipped = 0;
+    for (int i = 0; i < (int)merged.size(); i++) {
+        if ( merged[i]->skip ) n_skipped++;
+    }
+    if ( 2 * n_skipped <= (int)merged.size() ) return;
+
+    std::vector<int> position(merged.size(), -1);
+    int n = 0;
+    for (int i = 0; i < (int)merged.size(); i++) {
+        if ( merged[i]->skip ) continue;
+        position[i] = n;
+        merged[n++] = merged[i];
+    }
+    merged.resize(n);
+    for (auto it = index.begin(); it != index.end(); it++) {
+        it->second = position[it->second];
+    }
 }
 
 bool pq::compare_strings(std::shared_ptr<pq> ordered_1, std::shared_ptr<pq> ordered_2, int & n_permute) {
@@ -1772,7 +1910,7 @@ bool pq::compare_strings(std::shared_ptr<pq> ordered_1, std::shared_ptr<pq> orde
             nsame_s++;
         }
     }
-    if ( nsame_s != ordered_1->symbol.size() ) return false;
+    if ( nsame_s != (int)ordered_1->symbol.size() ) return false;
     //printf("same strings\n");
 
     // same delta functions (recall these aren't sorted in any way)
@@ -2023,7 +2161,7 @@ bool pq::compare_strings(std::shared_ptr<pq> ordered_1, std::shared_ptr<pq> orde
 */
 
     // if not the same, check antisymmetry <ij||kl> = -<ji||lk> = -<ij||lk> = <ji||lk>
-    if ( nsame_t != ordered_1->data->tensor.size() ) {
+    if ( nsame_t != (int)ordered_1->data->tensor.size() ) {
 
         if ( ordered_1->data->tensor.size() == 4 ) {
 
@@ -2046,7 +2184,7 @@ bool pq::compare_strings(std::shared_ptr<pq> ordered_1, std::shared_ptr<pq> orde
 
         }
     }
-    if ( nsame_t != ordered_1->data->tensor.size() ) {
+    if ( nsame_t != (int)ordered_1->data->tensor.size() ) {
 
         if ( ordered_1->data->tensor.size() == 4 ) {
 
@@ -2069,7 +2207,7 @@ bool pq::compare_strings(std::shared_ptr<pq> ordered_1, std::shared_ptr<pq> orde
 
         }
     }
-    if ( nsame_t != ordered_1->data->tensor.size() ) {
+    if ( nsame_t != (int)ordered_1->data->tensor.size() ) {
 
         if ( ordered_1->data->tensor.size() == 4 ) {
 
@@ -2090,13 +2228,487 @@ bool pq::compare_strings(std::shared_ptr<pq> ordered_1, std::shared_ptr<pq> orde
         }
     }
 
-    if ( nsame_t != ordered_1->data->tensor.size() ) {
+    if ( nsame_t != (int)ordered_1->data->tensor.size() ) {
         return false;
     }
 
     return true;
 }
 
+// a key for grouping strings that might be the same. strings that 
+// compare_strings could consider the same (including after the i/j and a/b 
+// swaps tried in cleanup) always have the same key, so only strings with equal
+// keys need to be compared.
+std::string pq::comparison_key() {
+
+    // labels i and j (a and b) could be swapped in cleanup
+    static const label i_label("i"), j_label("j"), a_label("a"), b_label("b");
+    auto swappable_id = [&](const label & idx) {
+        if ( idx == j_label ) return i_label.id();
+        if ( idx == b_label ) return a_label.id();
+        return idx.id();
+    };
+
+    std::string key;
+
+    // w0, u0, r0, l0, m0, s0
+    key += data->has_u0 ? '1' : '0';
+    key += data->has_m0 ? '1' : '0';
+    key += data->has_s0 ? '1' : '0';
+    key += data->has_w0 ? '1' : '0';
+    key += data->has_r0 ? '1' : '0';
+    key += data->has_l0 ? '1' : '0';
+
+    // fermionic operators (these must match exactly)
+    key += "|";
+    for (int k = 0; k < (int)symbol.size(); k++) {
+        key += std::to_string(symbol[k].id()) + ",";
+    }
+
+    // delta functions, in any order
+    key += "|";
+    std::vector<std::pair<int, int> > deltas;
+    for (int k = 0; k < (int)delta1.size(); k++) {
+        int id1 = delta1[k].id();
+        int id2 = delta2[k].id();
+        deltas.push_back(std::make_pair(std::min(id1, id2), std::max(id1, id2)));
+    }
+    std::sort(deltas.begin(), deltas.end());
+    for (int k = 0; k < (int)deltas.size(); k++) {
+        key += std::to_string(deltas[k].first) + "," + std::to_string(deltas[k].second) + ";";
+    }
+
+    // tensor type and labels, in any order
+    key += "|" + data->tensor_type + "|";
+    std::vector<int> labels;
+    for (int k = 0; k < (int)data->tensor.size(); k++) {
+        labels.push_back(swappable_id(data->tensor[k]));
+    }
+    std::sort(labels.begin(), labels.end());
+    for (int k = 0; k < (int)labels.size(); k++) {
+        key += std::to_string(labels[k]) + ",";
+    }
+
+    // amplitudes: rank of each amplitude and the set of labels involved
+    std::vector< std::vector<std::vector<label> > * > amplitudes = {
+        &data->t_amplitudes, &data->u_amplitudes, &data->m_amplitudes,
+        &data->s_amplitudes, &data->left_amplitudes, &data->right_amplitudes };
+
+    for (int a = 0; a < (int)amplitudes.size(); a++) {
+
+        key += "|";
+
+        std::vector<int> ranks;
+        labels.clear();
+        for (int k = 0; k < (int)amplitudes[a]->size(); k++) {
+            ranks.push_back((int)amplitudes[a]->at(k).size());
+            for (int l = 0; l < (int)amplitudes[a]->at(k).size(); l++) {
+                labels.push_back(swappable_id(amplitudes[a]->at(k)[l]));
+            }
+        }
+        std::sort(ranks.begin(), ranks.end());
+        std::sort(labels.begin(), labels.end());
+        labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+
+        for (int k = 0; k < (int)ranks.size(); k++) {
+            key += std::to_string(ranks[k]) + ",";
+        }
+        key += ":";
+        for (int k = 0; k < (int)labels.size(); k++) {
+            key += std::to_string(labels[k]) + ",";
+        }
+    }
+
+    return key;
+}
+
+// labels given to summation indices by use_conventional_labels and canonicalize
+static const std::vector<label> & conventional_labels(bool occupied) {
+
+    static const std::vector<label> occ_out{"i","j","k","l","m","n","o",
+                                            "i0","i1","i2","i3","i4","i5","i6","i7","i8","i9",
+                                            "i10","i11","i12","i13","i14","i15","i16","i17","i18","i19"};
+    static const std::vector<label> vir_out{"a","b","c","d","e","f","g",
+                                            "a0","a1","a2","a3","a4","a5","a6","a7","a8","a9",
+                                            "a10","a11","a12","a13","a14","a15","a16","a17","a18","a19"};
+
+    return occupied ? occ_out : vir_out;
+}
+
+namespace {
+
+// a tensor or amplitude, and the permutations of its labels that leave it unchanged (up to a sign)
+struct canonical_factor {
+    std::vector<label> labels;
+    const std::vector<label_permutation> * symmetries;
+};
+
+// search for the relabeling of summation indices (and the ordering of amplitudes
+// and the permutation of labels within each tensor) that gives the lexicographically 
+// smallest sequence of codes. each label is coded by whether it is summed or 
+// external, its class (occupied or virtual), and either the order in which it
+// was first encountered or the rank of its name among the external labels.
+struct canonical_search {
+
+    // factors, by category (tensor, then t, u, m, s, left, right amplitudes)
+    std::vector<std::vector<canonical_factor> > factors;
+
+    // delta functions
+    std::vector<std::pair<label, label> > deltas;
+
+    // codes for external labels and for summation labels encountered so far
+    std::unordered_map<label, int> code;
+
+    // number of summation labels encountered so far, by class
+    int n_summed[3] = {0, 0, 0};
+
+    // codes so far
+    std::vector<int> tokens;
+
+    // first position at which tokens is smaller than best_tokens (-1 if they are equal so far)
+    int first_less = -1;
+
+    // number of label transpositions made so far
+    int parity = 0;
+
+    // factors in the order chosen so far, with labels permuted
+    std::vector<std::vector<canonical_factor> > arranged;
+
+    // best arrangement so far
+    bool have_best = false;
+    std::vector<int> best_tokens;
+    int best_parity = 0;
+    std::vector<std::vector<canonical_factor> > best_arranged;
+    std::unordered_map<label, int> best_code;
+
+    // is there an arrangement equivalent to the best one, but of opposite sign?
+    bool vanishes = false;
+
+    static int label_class(const label & idx) {
+        if ( idx.is_occ() ) return 0;
+        if ( idx.is_vir() ) return 1;
+        return 2;
+    }
+
+    // summation labels sort before externals, and occupied labels before virtual ones
+    static int external_code(const label & idx, int rank) {
+        return 3000000 + label_class(idx) * 1000000 + rank;
+    }
+
+    int new_summed_code(const label & idx) {
+        int c = label_class(idx);
+        return c * 1000000 + n_summed[c]++;
+    }
+
+    // append codes, comparing with the best arrangement. returns false if the 
+    // arrangement so far is already worse than the best one
+    bool push(int token) {
+        if ( have_best && first_less < 0 ) {
+            int best = best_tokens[tokens.size()];
+            if ( token > best ) return false;
+            if ( token < best ) first_less = (int)tokens.size();
+        }
+        tokens.push_back(token);
+        return true;
+    }
+
+    // remove codes added since tokens had n entries
+    void truncate(size_t n) {
+        tokens.resize(n);
+        if ( first_less >= (int)n ) first_less = -1;
+    }
+
+    void leaf() {
+
+        // delta functions come last, and summation labels rarely appear in them
+        std::vector<label> added;
+        std::vector<std::pair<int, int> > pairs;
+        for (int i = 0; i < (int)deltas.size(); i++) {
+            for (int k = 0; k < 2; k++) {
+                const label & idx = k == 0 ? deltas[i].first : deltas[i].second;
+                if ( code.find(idx) == code.end() ) {
+                    code[idx] = new_summed_code(idx);
+                    added.push_back(idx);
+                }
+            }
+            int c1 = code[deltas[i].first];
+            int c2 = code[deltas[i].second];
+            pairs.push_back(std::make_pair(std::min(c1, c2), std::max(c1, c2)));
+        }
+        std::sort(pairs.begin(), pairs.end());
+
+        size_t n_tokens = tokens.size();
+        bool worse = false;
+        for (int i = 0; i < (int)pairs.size(); i++) {
+            if ( !push(pairs[i].first) || !push(pairs[i].second) ) {
+                worse = true;
+                break;
+            }
+        }
+
+        if ( !worse ) {
+            if ( !have_best || first_less >= 0 ) {
+                have_best     = true;
+                best_tokens   = tokens;
+                best_parity   = parity;
+                best_arranged = arranged;
+                best_code     = code;
+                vanishes      = false;
+                first_less    = -1;
+            }else if ( ( parity - best_parity ) % 2 != 0 ) {
+                vanishes = true;
+            }
+        }
+
+        truncate(n_tokens);
+        for (int i = 0; i < (int)added.size(); i++) {
+            code.erase(added[i]);
+            n_summed[label_class(added[i])]--;
+        }
+    }
+
+    // choose the next factor in category c
+    void choose(int c, std::vector<bool> & used) {
+
+        int n_used = 0;
+        for (int f = 0; f < (int)used.size(); f++) {
+            if ( used[f] ) n_used++;
+        }
+        if ( n_used == (int)used.size() ) {
+            if ( c + 1 == (int)factors.size() ) {
+                leaf();
+            }else {
+                std::vector<bool> next_used(factors[c + 1].size(), false);
+                choose(c + 1, next_used);
+            }
+            return;
+        }
+
+        for (int f = 0; f < (int)used.size(); f++) {
+
+            if ( used[f] ) continue;
+
+            size_t n_tokens = tokens.size();
+
+            // lower-rank amplitudes come first
+            if ( push((int)factors[c][f].labels.size()) ) {
+                used[f] = true;
+                arranged[c].push_back(factors[c][f]);
+                place(c, used, f);
+                arranged[c].pop_back();
+                used[f] = false;
+            }
+
+            truncate(n_tokens);
+        }
+    }
+
+    // try each symmetry-equivalent permutation of the labels of factor f (category c). 
+    // new summation labels are coded in the order they are encountered
+    void place(int c, std::vector<bool> & used, int f) {
+
+        const canonical_factor & me = factors[c][f];
+
+        for (int p = 0; p < (int)me.symmetries->size(); p++) {
+
+            const label_permutation & permutation = me.symmetries->at(p);
+
+            size_t n_tokens = tokens.size();
+            int my_parity = parity;
+
+            std::vector<label> permuted;
+            std::vector<label> added;
+            bool worse = false;
+            for (int k = 0; k < (int)me.labels.size(); k++) {
+                const label & idx = me.labels[permutation.order[k]];
+                permuted.push_back(idx);
+                auto it = code.find(idx);
+                if ( it == code.end() ) {
+                    it = code.insert(std::make_pair(idx, new_summed_code(idx))).first;
+                    added.push_back(idx);
+                }
+                if ( !push(it->second) ) {
+                    worse = true;
+                    break;
+                }
+            }
+            if ( permutation.sign < 0 ) parity++;
+
+            // (arranged[c] may grow during the recursion, so don't hold a reference to it)
+            if ( !worse ) {
+                arranged[c].back().labels = permuted;
+                choose(c, used);
+                arranged[c].back().labels = me.labels;
+            }
+
+            truncate(n_tokens);
+            parity = my_parity;
+            for (int i = (int)added.size() - 1; i >= 0; i--) {
+                code.erase(added[i]);
+                n_summed[label_class(added[i])]--;
+            }
+        }
+    }
+};
+
+}
+
+// relabel summation indices, order amplitudes, and permute labels within 
+// tensors (according to their symmetries; see tensor_symmetry.cc) so that 
+// equivalent fully-contracted strings become identical. summation indices are 
+// the labels that appear exactly twice. returns a key that is the same for 
+// identical strings
+std::string pq::canonicalize(bool real_orbitals) {
+
+    std::vector< std::vector<std::vector<label> > * > amplitudes = {
+        &data->t_amplitudes, &data->u_amplitudes, &data->m_amplitudes,
+        &data->s_amplitudes, &data->left_amplitudes, &data->right_amplitudes };
+
+    canonical_search search;
+
+    search.factors.resize(1 + amplitudes.size());
+    if ( data->tensor.size() > 0 ) {
+        search.factors[0].push_back({data->tensor, 
+            &tensor_symmetries(data->tensor_type, (int)data->tensor.size(), real_orbitals)});
+    }
+    for (int a = 0; a < (int)amplitudes.size(); a++) {
+        for (int k = 0; k < (int)amplitudes[a]->size(); k++) {
+            search.factors[a + 1].push_back({amplitudes[a]->at(k), 
+                &tensor_symmetries("AMPLITUDE", (int)amplitudes[a]->at(k).size(), real_orbitals)});
+        }
+    }
+    for (int k = 0; k < (int)delta1.size(); k++) {
+        search.deltas.push_back(std::make_pair(delta1[k], delta2[k]));
+    }
+
+    // count appearances of each label
+    std::unordered_map<label, int> count;
+    for (int c = 0; c < (int)search.factors.size(); c++) {
+        for (int f = 0; f < (int)search.factors[c].size(); f++) {
+            const std::vector<label> & labels = search.factors[c][f].labels;
+            for (int i = 0; i < (int)labels.size(); i++) {
+                count[labels[i]]++;
+            }
+        }
+    }
+    for (int k = 0; k < (int)search.deltas.size(); k++) {
+        count[search.deltas[k].first]++;
+        count[search.deltas[k].second]++;
+    }
+
+    // external labels are coded by name. so are labels that are neither occupied 
+    // nor virtual, which are left alone
+    std::vector<label> externals;
+    for (auto & entry : count) {
+        if ( entry.second != 2 || canonical_search::label_class(entry.first) == 2 ) {
+            externals.push_back(entry.first);
+        }
+    }
+    std::sort(externals.begin(), externals.end());
+    for (int i = 0; i < (int)externals.size(); i++) {
+        search.code[externals[i]] = canonical_search::external_code(externals[i], i);
+    }
+
+    search.arranged.resize(search.factors.size());
+    std::vector<bool> used(search.factors[0].size(), false);
+    search.choose(0, used);
+
+    if ( search.vanishes ) {
+        skip = true;
+        return "";
+    }
+
+    // new names for summation labels, skipping the names of external labels
+    std::unordered_map<label, label> new_name;
+    for (int c = 0; c < 2; c++) {
+        std::vector<label> summed;
+        for (auto & entry : search.best_code) {
+            if ( entry.second / 1000000 == c ) {
+                summed.push_back(entry.first);
+            }
+        }
+        std::sort(summed.begin(), summed.end(), [&](const label & a, const label & b) {
+            return search.best_code[a] < search.best_code[b];
+        });
+        const std::vector<label> & names = conventional_labels(c == 0);
+        int n = 0;
+        for (int i = 0; i < (int)summed.size(); i++) {
+            while ( n < (int)names.size() && count.find(names[n]) != count.end() && count[names[n]] != 2 ) n++;
+            if ( n == (int)names.size() ) {
+                printf("\n");
+                printf("    error: too many summation labels\n");
+                printf("\n");
+                exit(1);
+            }
+            new_name[summed[i]] = names[n++];
+        }
+    }
+    auto rename = [&](const label & idx) {
+        auto it = new_name.find(idx);
+        return it == new_name.end() ? idx : it->second;
+    };
+
+    // rewrite the string
+    if ( search.best_parity % 2 != 0 ) sign = -sign;
+
+    for (int c = 0; c < (int)search.best_arranged.size(); c++) {
+        std::vector<std::vector<label> > me;
+        for (int f = 0; f < (int)search.best_arranged[c].size(); f++) {
+            std::vector<label> labels;
+            for (int i = 0; i < (int)search.best_arranged[c][f].labels.size(); i++) {
+                labels.push_back(rename(search.best_arranged[c][f].labels[i]));
+            }
+            me.push_back(labels);
+        }
+        if ( c == 0 ) {
+            if ( me.size() > 0 ) data->tensor = me[0];
+        }else {
+            *amplitudes[c - 1] = me;
+        }
+    }
+
+    std::vector<std::pair<label, label> > new_deltas;
+    for (int k = 0; k < (int)delta1.size(); k++) {
+        label d1 = rename(delta1[k]);
+        label d2 = rename(delta2[k]);
+        if ( d2 < d1 ) std::swap(d1, d2);
+        new_deltas.push_back(std::make_pair(d1, d2));
+    }
+    std::sort(new_deltas.begin(), new_deltas.end());
+    for (int k = 0; k < (int)new_deltas.size(); k++) {
+        delta1[k] = new_deltas[k].first;
+        delta2[k] = new_deltas[k].second;
+    }
+
+    // key
+    std::string key;
+    key += data->has_u0 ? '1' : '0';
+    key += data->has_m0 ? '1' : '0';
+    key += data->has_s0 ? '1' : '0';
+    key += data->has_w0 ? '1' : '0';
+    key += data->has_r0 ? '1' : '0';
+    key += data->has_l0 ? '1' : '0';
+    key += "|" + data->tensor_type + "|";
+    for (int k = 0; k < (int)data->tensor.size(); k++) {
+        key += data->tensor[k].str() + ",";
+    }
+    for (int a = 0; a < (int)amplitudes.size(); a++) {
+        key += "|";
+        for (int k = 0; k < (int)amplitudes[a]->size(); k++) {
+            for (int l = 0; l < (int)amplitudes[a]->at(k).size(); l++) {
+                key += amplitudes[a]->at(k)[l].str() + ",";
+            }
+            key += ";";
+        }
+    }
+    key += "|";
+    for (int k = 0; k < (int)delta1.size(); k++) {
+        key += delta1[k].str() + "," + delta2[k].str() + ";";
+    }
+
+    return key;
+}
+
 // copy all data, except symbols and daggers. 
 
 void pq::shallow_copy(void * copy_me) { 
@@ -2113,8 +2725,8 @@ void pq::shallow_copy(void * copy_me) {
     data->factor = in->data->factor;
 
     // temporary delta functions
-    std::vector<std::string> tmp_delta1;
-    std::vector<std::string> tmp_delta2;
+    std::vector<label> tmp_delta1;
+    std::vector<label> tmp_delta2;
 
     // data->tensor
     for (int i = 0; i < (int)in->data->tensor.size(); i++) {
@@ -2131,58 +2743,22 @@ void pq::shallow_copy(void * copy_me) {
     }
 
     // t_amplitudes
-    for (int i = 0; i < (int)in->data->t_amplitudes.size(); i++) {
-        std::vector<std::string> tmp;
-        for (int j = 0; j < (int)in->data->t_amplitudes[i].size(); j++) {
-            tmp.push_back(in->data->t_amplitudes[i][j]);
-        }
-        data->t_amplitudes.push_back(tmp);
-    }
+    data->copy_amplitudes(data->t_amplitudes, in->data->t_amplitudes);
 
     // u_amplitudes
-    for (int i = 0; i < (int)in->data->u_amplitudes.size(); i++) {
-        std::vector<std::string> tmp;
-        for (int j = 0; j < (int)in->data->u_amplitudes[i].size(); j++) {
-            tmp.push_back(in->data->u_amplitudes[i][j]);
-        }
-        data->u_amplitudes.push_back(tmp);
-    }
+    data->copy_amplitudes(data->u_amplitudes, in->data->u_amplitudes);
 
     // m_amplitudes
-    for (int i = 0; i < (int)in->data->m_amplitudes.size(); i++) {
-        std::vector<std::string> tmp;
-        for (int j = 0; j < (int)in->data->m_amplitudes[i].size(); j++) {
-            tmp.push_back(in->data->m_amplitudes[i][j]);
-        }
-        data->m_amplitudes.push_back(tmp);
-    }
+    data->copy_amplitudes(data->m_amplitudes, in->data->m_amplitudes);
 
     // s_amplitudes
-    for (int i = 0; i < (int)in->data->s_amplitudes.size(); i++) {
-        std::vector<std::string> tmp;
-        for (int j = 0; j < (int)in->data->s_amplitudes[i].size(); j++) {
-            tmp.push_back(in->data->s_amplitudes[i][j]);
-        }
-        data->s_amplitudes.push_back(tmp);
-    }
+    data->copy_amplitudes(data->s_amplitudes, in->data->s_amplitudes);
 
     // left-hand amplitudes
-    for (int i = 0; i < (int)in->data->left_amplitudes.size(); i++) {
-        std::vector<std::string> tmp;
-        for (int j = 0; j < (int)in->data->left_amplitudes[i].size(); j++) {
-            tmp.push_back(in->data->left_amplitudes[i][j]);
-        }
-        data->left_amplitudes.push_back(tmp);
-    }
+    data->copy_amplitudes(data->left_amplitudes, in->data->left_amplitudes);
 
     // right-hand amplitudes
-    for (int i = 0; i < (int)in->data->right_amplitudes.size(); i++) {
-        std::vector<std::string> tmp;
-        for (int j = 0; j < (int)in->data->right_amplitudes[i].size(); j++) {
-            tmp.push_back(in->data->right_amplitudes[i][j]);
-        }
-        data->right_amplitudes.push_back(tmp);
-    }
+    data->copy_amplitudes(data->right_amplitudes, in->data->right_amplitudes);
 
     // l0 
     data->has_l0 = in->data->has_l0;
@@ -2213,7 +2789,7 @@ void pq::shallow_copy(void * copy_me) {
 }
 
 
-bool pq::index_in_anywhere(std::string idx) {
+bool pq::index_in_anywhere(label idx) {
 
     if ( index_in_tensor(idx) ) {
         return true;
@@ -2234,7 +2810,7 @@ bool pq::index_in_anywhere(std::string idx) {
 
 }
 
-bool pq::index_in_tensor(std::string idx) {
+bool pq::index_in_tensor(label idx) {
 
     for (int i = 0; i < (int)data->tensor.size(); i++) {
         if ( data->tensor[i] == idx ) {
@@ -2245,7 +2821,7 @@ bool pq::index_in_tensor(std::string idx) {
 
 }
 
-bool pq::index_in_t_amplitudes(std::string idx) {
+bool pq::index_in_t_amplitudes(label idx) {
 
     for (int i = 0; i < (int)data->t_amplitudes.size(); i++) {
         for (int j = 0; j < (int)data->t_amplitudes[i].size(); j++) {
@@ -2259,7 +2835,7 @@ bool pq::index_in_t_amplitudes(std::string idx) {
 
 }
 
-bool pq::index_in_u_amplitudes(std::string idx) {
+bool pq::index_in_u_amplitudes(label idx) {
 
     for (int i = 0; i < (int)data->u_amplitudes.size(); i++) {
         for (int j = 0; j < (int)data->u_amplitudes[i].size(); j++) {
@@ -2273,7 +2849,7 @@ bool pq::index_in_u_amplitudes(std::string idx) {
 
 }
 
-bool pq::index_in_m_amplitudes(std::string idx) {
+bool pq::index_in_m_amplitudes(label idx) {
 
     for (int i = 0; i < (int)data->m_amplitudes.size(); i++) {
         for (int j = 0; j < (int)data->m_amplitudes[i].size(); j++) {
@@ -2287,7 +2863,7 @@ bool pq::index_in_m_amplitudes(std::string idx) {
 
 }
 
-bool pq::index_in_s_amplitudes(std::string idx) {
+bool pq::index_in_s_amplitudes(label idx) {
 
     for (int i = 0; i < (int)data->s_amplitudes.size(); i++) {
         for (int j = 0; j < (int)data->s_amplitudes[i].size(); j++) {
@@ -2301,7 +2877,7 @@ bool pq::index_in_s_amplitudes(std::string idx) {
 
 }
 
-bool pq::index_in_left_amplitudes(std::string idx) {
+bool pq::index_in_left_amplitudes(label idx) {
 
     for (int i = 0; i < (int)data->left_amplitudes.size(); i++) {
         for (int j = 0; j < (int)data->left_amplitudes[i].size(); j++) {
@@ -2315,7 +2891,7 @@ bool pq::index_in_left_amplitudes(std::string idx) {
 
 }
 
-bool pq::index_in_right_amplitudes(std::string idx) {
+bool pq::index_in_right_amplitudes(label idx) {
 
     for (int i = 0; i < (int)data->right_amplitudes.size(); i++) {
         for (int j = 0; j < (int)data->right_amplitudes[i].size(); j++) {
@@ -2329,7 +2905,7 @@ bool pq::index_in_right_amplitudes(std::string idx) {
 
 }
 
-void pq::replace_index_everywhere(std::string old_idx, std::string new_idx) {
+void pq::replace_index_everywhere(label old_idx, label new_idx) {
 
     replace_index_in_tensor(old_idx,new_idx);
     replace_index_in_t_amplitudes(old_idx,new_idx);
@@ -2341,7 +2917,7 @@ void pq::replace_index_everywhere(std::string old_idx, std::string new_idx) {
 
 }
 
-void pq::replace_index_in_tensor(std::string old_idx, std::string new_idx) {
+void pq::replace_index_in_tensor(label old_idx, label new_idx) {
 
     for (int i = 0; i < (int)data->tensor.size(); i++) {
         if ( data->tensor[i] == old_idx ) {
@@ -2353,7 +2929,7 @@ void pq::replace_index_in_tensor(std::string old_idx, std::string new_idx) {
 
 }
 
-void pq::replace_index_in_t_amplitudes(std::string old_idx, std::string new_idx) {
+void pq::replace_index_in_t_amplitudes(label old_idx, label new_idx) {
 
     for (int i = 0; i < (int)data->t_amplitudes.size(); i++) {
         for (int j = 0; j < (int)data->t_amplitudes[i].size(); j++) {
@@ -2366,7 +2942,7 @@ void pq::replace_index_in_t_amplitudes(std::string old_idx, std::string new_idx)
 
 }
 
-void pq::replace_index_in_u_amplitudes(std::string old_idx, std::string new_idx) {
+void pq::replace_index_in_u_amplitudes(label old_idx, label new_idx) {
 
     for (int i = 0; i < (int)data->u_amplitudes.size(); i++) {
         for (int j = 0; j < (int)data->u_amplitudes[i].size(); j++) {
@@ -2379,7 +2955,7 @@ void pq::replace_index_in_u_amplitudes(std::string old_idx, std::string new_idx)
 
 }
 
-void pq::replace_index_in_m_amplitudes(std::string old_idx, std::string new_idx) {
+void pq::replace_index_in_m_amplitudes(label old_idx, label new_idx) {
 
     for (int i = 0; i < (int)data->m_amplitudes.size(); i++) {
         for (int j = 0; j < (int)data->m_amplitudes[i].size(); j++) {
@@ -2392,7 +2968,7 @@ void pq::replace_index_in_m_amplitudes(std::string old_idx, std::string new_idx)
 
 }
 
-void pq::replace_index_in_s_amplitudes(std::string old_idx, std::string new_idx) {
+void pq::replace_index_in_s_amplitudes(label old_idx, label new_idx) {
 
     for (int i = 0; i < (int)data->s_amplitudes.size(); i++) {
         for (int j = 0; j < (int)data->s_amplitudes[i].size(); j++) {
@@ -2405,7 +2981,7 @@ void pq::replace_index_in_s_amplitudes(std::string old_idx, std::string new_idx)
 
 }
 
-void pq::replace_index_in_left_amplitudes(std::string old_idx, std::string new_idx) {
+void pq::replace_index_in_left_amplitudes(label old_idx, label new_idx) {
 
     for (int i = 0; i < (int)data->left_amplitudes.size(); i++) {
         for (int j = 0; j < (int)data->left_amplitudes[i].size(); j++) {
@@ -2418,7 +2994,7 @@ void pq::replace_index_in_left_amplitudes(std::string old_idx, std::string new_i
 
 }
 
-void pq::replace_index_in_right_amplitudes(std::string old_idx, std::string new_idx) {
+void pq::replace_index_in_right_amplitudes(label old_idx, label new_idx) {
 
     for (int i = 0; i < (int)data->right_amplitudes.size(); i++) {
         for (int j = 0; j < (int)data->right_amplitudes[i].size(); j++) {
@@ -2435,12 +3011,10 @@ void pq::replace_index_in_right_amplitudes(std::string old_idx, std::string new_
 void pq::use_conventional_labels() {
 
     // occupied first:
-    std::vector<std::string> occ_in{"o0","o1","o2","o3","o4","o5","o6","o7","o8","o9",
-                                    "o10","o11","o12","o13","o14","o15","o16","o17","o18","o19",
-                                    "o20","o21","o22","o23","o24","o25","o26","o27","o28","o29"};
-    std::vector<std::string> occ_out{"i","j","k","l","m","n","o",
-                                     "i0","i1","i2","i3","i4","i5","i6","i7","i8","i9",
-                                     "i10","i11","i12","i13","i14","i15","i16","i17","i18","i19"};
+    static const std::vector<label> occ_in{"o0","o1","o2","o3","o4","o5","o6","o7","o8","o9",
+                                           "o10","o11","o12","o13","o14","o15","o16","o17","o18","o19",
+                                           "o20","o21","o22","o23","o24","o25","o26","o27","o28","o29"};
+    const std::vector<label> & occ_out = conventional_labels(true);
 
     for (int i = 0; i < (int)occ_in.size(); i++) {
 
@@ -2460,12 +3034,10 @@ void pq::use_conventional_labels() {
     }
 
     // now virtual
-    std::vector<std::string> vir_in{"v0","v1","v2","v3","v4","v5","v6","v7","v8","v9",
-                                    "v10","v11","v12","v13","v14","v15","v16","v17","v18","v19",
-                                    "v20","v21","v22","v23","v24","v25","v26","v27","v28","v29"};
-    std::vector<std::string> vir_out{"a","b","c","d","e","f","g",
-                                     "a0","a1","a2","a3","a4","a5","a6","a7","a8","a9",
-                                     "a10","a11","a12","a13","a14","a15","a16","a17","a18","a19"};
+    static const std::vector<label> vir_in{"v0","v1","v2","v3","v4","v5","v6","v7","v8","v9",
+                                           "v10","v11","v12","v13","v14","v15","v16","v17","v18","v19",
+                                           "v20","v21","v22","v23","v24","v25","v26","v27","v28","v29"};
+    const std::vector<label> & vir_out = conventional_labels(false);
 
     for (int i = 0; i < (int)vir_in.size(); i++) {
 
@@ -2486,8 +3058,8 @@ void pq::use_conventional_labels() {
 
 void pq::gobble_deltas() {
 
-    std::vector<std::string> tmp_delta1;
-    std::vector<std::string> tmp_delta2;
+    std::vector<label> tmp_delta1;
+    std::vector<label> tmp_delta2;
 
     for (int i = 0; i < (int)delta1.size(); i++) {
 
@@ -2574,16 +3146,14 @@ void pq::copy(void * copy_me) {
     pq * in = reinterpret_cast<pq * >(copy_me);
 
     // operators
-    for (int j = 0; j < (int)in->symbol.size(); j++) {
-        symbol.push_back(in->symbol[j]);
+    symbol.insert(symbol.end(), in->symbol.begin(), in->symbol.end());
 
-        // dagger?
-        is_dagger.push_back(in->is_dagger[j]);
+    // dagger?
+    is_dagger = in->is_dagger;
 
-        // dagger (relative to fermi vacuum)?
-        if ( vacuum == "FERMI" ) {
-            is_dagger_fermi.push_back(in->is_dagger_fermi[j]);
-        }
+    // dagger (relative to fermi vacuum)?
+    if ( fermi_vacuum ) {
+        is_dagger_fermi = in->is_dagger_fermi;
     }
 
     // boson daggers
@@ -2597,10 +3167,10 @@ bool pq::normal_order_true_vacuum(std::vector<std::shared_ptr<pq> > &ordered) {
 
     if ( skip ) return true;
 
-    if ( is_normal_order() ) {
+    if ( is_normal_order<false>() ) {
 
         // push current ordered operator onto running list
-        std::shared_ptr<pq> newguy (new pq(vacuum));
+        std::shared_ptr<pq> newguy = new_string();
 
         newguy->copy((void*)this);
 
@@ -2610,8 +3180,8 @@ bool pq::normal_order_true_vacuum(std::vector<std::shared_ptr<pq> > &ordered) {
     }
 
     // new strings
-    std::shared_ptr<pq> s1 ( new pq(vacuum) );
-    std::shared_ptr<pq> s2 ( new pq(vacuum) );
+    std::shared_ptr<pq> s1 = new_string();
+    std::shared_ptr<pq> s2 = new_string();
 
     // copy data common to both new strings
     s1->shallow_copy((void*)this);
@@ -2674,10 +3244,10 @@ bool pq::normal_order_true_vacuum(std::vector<std::shared_ptr<pq> > &ordered) {
     }else {
 
         // new strings
-        std::shared_ptr<pq> s1a ( new pq(vacuum) );
-        std::shared_ptr<pq> s1b ( new pq(vacuum) );
-        std::shared_ptr<pq> s2a ( new pq(vacuum) );
-        std::shared_ptr<pq> s2b ( new pq(vacuum) );
+        std::shared_ptr<pq> s1a = new_string();
+        std::shared_ptr<pq> s1b = new_string();
+        std::shared_ptr<pq> s2a = new_string();
+        std::shared_ptr<pq> s2b = new_string();
 
         // copy data common to new strings
         s1a->copy((void*)s1.get());
@@ -2770,10 +3340,10 @@ bool pq::normal_order_fermi_vacuum(std::vector<std::shared_ptr<pq> > &ordered) {
 
     if ( skip ) return true;
 
-    if ( is_normal_order() ) {
+    if ( is_normal_order<true>() ) {
 
         // push current ordered operator onto running list
-        std::shared_ptr<pq> newguy (new pq(vacuum));
+        std::shared_ptr<pq> newguy = new_string();
 
         newguy->copy((void*)this);
 
@@ -2783,8 +3353,8 @@ bool pq::normal_order_fermi_vacuum(std::vector<std::shared_ptr<pq> > &ordered) {
     }
 
     // new strings
-    std::shared_ptr<pq> s1 ( new pq(vacuum) );
-    std::shared_ptr<pq> s2 ( new pq(vacuum) );
+    std::shared_ptr<pq> s1 = new_string();
+    std::shared_ptr<pq> s2 = new_string();
 
     // copy data common to both new strings
     s1->shallow_copy((void*)this);
@@ -2794,82 +3364,58 @@ bool pq::normal_order_fermi_vacuum(std::vector<std::shared_ptr<pq> > &ordered) {
 
     int n_new_strings = 1;
 
-    for (int i = 0; i < (int)symbol.size()-1; i++) {
-
-        bool swap = ( !is_dagger_fermi[i] && is_dagger_fermi[i+1] );
-
-        // four cases: **, --, *-, -*
-        // **, --: change sign, swap labels
-        // *-, -*: standard swap
-
-        bool daggers_differ = ( is_dagger[i] != is_dagger[i+1] );
-
-        if ( swap && daggers_differ ) {
-
-            // we're going to have two new strings
-            n_new_strings = 2;
-
-            s1->delta1.push_back(symbol[i]);
-            s1->delta2.push_back(symbol[i+1]);
-
-            s2->sign = -s2->sign;
-            s2->symbol.push_back(symbol[i+1]);
-            s2->symbol.push_back(symbol[i]);
-            s2->is_dagger.push_back(is_dagger[i+1]);
-            s2->is_dagger.push_back(is_dagger[i]);
-            s2->is_dagger_fermi.push_back(is_dagger_fermi[i+1]);
-            s2->is_dagger_fermi.push_back(is_dagger_fermi[i]);
-
-            for (int j = i+2; j < (int)symbol.size(); j++) {
-
-                s1->symbol.push_back(symbol[j]);
-                s2->symbol.push_back(symbol[j]);
-
-                s1->is_dagger.push_back(is_dagger[j]);
-                s2->is_dagger.push_back(is_dagger[j]);
+    // the first pair of operators that is out of order (a bit scan)
+    int i = is_dagger_fermi.first_inversion();
 
-                s1->is_dagger_fermi.push_back(is_dagger_fermi[j]);
-                s2->is_dagger_fermi.push_back(is_dagger_fermi[j]);
+    if ( i < 0 ) {
 
-            }
-            break;
+        // only the bosons are out of order
+        s1->symbol = symbol;
+        s1->is_dagger = is_dagger;
+        s1->is_dagger_fermi = is_dagger_fermi;
 
-        }else if ( swap && !daggers_differ )  {
+        s2->symbol = symbol;
+        s2->is_dagger = is_dagger;
+        s2->is_dagger_fermi = is_dagger_fermi;
 
-            // we're only going to have one new string, with a different sign
-            n_new_strings = 1;
+    }else if ( is_dagger[i] != is_dagger[i+1] ) {
 
-            s1->sign = -s1->sign;
-            s1->symbol.push_back(symbol[i+1]);
-            s1->symbol.push_back(symbol[i]);
-            s1->is_dagger.push_back(is_dagger[i+1]);
-            s1->is_dagger.push_back(is_dagger[i]);
-            s1->is_dagger_fermi.push_back(is_dagger_fermi[i+1]);
-            s1->is_dagger_fermi.push_back(is_dagger_fermi[i]);
+        // *-, -*: standard swap. we're going to have two new strings
 
-            for (int j = i+2; j < (int)symbol.size(); j++) {
+        n_new_strings = 2;
 
-                s1->symbol.push_back(symbol[j]);
-
-                s1->is_dagger.push_back(is_dagger[j]);
+        // a delta function in place of the pair
+        s1->delta1.push_back(symbol[i]);
+        s1->delta2.push_back(symbol[i+1]);
 
-                s1->is_dagger_fermi.push_back(is_dagger_fermi[j]);
+        s1->symbol.assign(symbol.begin(), symbol.begin() + i);
+        s1->symbol.insert(s1->symbol.end(), symbol.begin() + i + 2, symbol.end());
+        s1->is_dagger = is_dagger;
+        s1->is_dagger.erase_pair(i);
+        s1->is_dagger_fermi = is_dagger_fermi;
+        s1->is_dagger_fermi.erase_pair(i);
 
-            }
-            break;
+        // the swapped pair, with a different sign
+        s2->sign = -s2->sign;
+        s2->symbol = symbol;
+        std::swap(s2->symbol[i], s2->symbol[i+1]);
+        s2->is_dagger = is_dagger;
+        s2->is_dagger.swap_adjacent(i);
+        s2->is_dagger_fermi = is_dagger_fermi;
+        s2->is_dagger_fermi.swap_adjacent(i);
 
-        }else {
-
-            s1->symbol.push_back(symbol[i]);
-            s2->symbol.push_back(symbol[i]);
+    }else {
 
-            s1->is_dagger.push_back(is_dagger[i]);
-            s2->is_dagger.push_back(is_dagger[i]);
+        // **, --: change sign, swap labels. we're only going to have one new string
 
-            s1->is_dagger_fermi.push_back(is_dagger_fermi[i]);
-            s2->is_dagger_fermi.push_back(is_dagger_fermi[i]);
+        s1->sign = -s1->sign;
+        s1->symbol = symbol;
+        std::swap(s1->symbol[i], s1->symbol[i+1]);
+        s1->is_dagger = is_dagger;
+        s1->is_dagger.swap_adjacent(i);
+        s1->is_dagger_fermi = is_dagger_fermi;
+        s1->is_dagger_fermi.swap_adjacent(i);
 
-        }
     }
 
     // now, s1 (and s2) are closer to normal order in the fermion space
@@ -2890,8 +3436,8 @@ bool pq::normal_order_fermi_vacuum(std::vector<std::shared_ptr<pq> > &ordered) {
         }else {
 
             // new strings
-            std::shared_ptr<pq> s1a ( new pq(vacuum) );
-            std::shared_ptr<pq> s1b ( new pq(vacuum) );
+            std::shared_ptr<pq> s1a = new_string();
+            std::shared_ptr<pq> s1b = new_string();
 
             // copy data common to both new strings
             s1a->copy((void*)s1.get());
@@ -2953,10 +3499,10 @@ bool pq::normal_order_fermi_vacuum(std::vector<std::shared_ptr<pq> > &ordered) {
         }else {
 
             // new strings
-            std::shared_ptr<pq> s1a ( new pq(vacuum) );
-            std::shared_ptr<pq> s1b ( new pq(vacuum) );
-            std::shared_ptr<pq> s2a ( new pq(vacuum) );
-            std::shared_ptr<pq> s2b ( new pq(vacuum) );
+            std::shared_ptr<pq> s1a = new_string();
+            std::shared_ptr<pq> s1b = new_string();
+            std::shared_ptr<pq> s2a = new_string();
+            std::shared_ptr<pq> s2b = new_string();
 
             // copy data common to new strings
             s1a->copy((void*)s1.get());
@@ -3047,11 +3593,143 @@ bool pq::normal_order_fermi_vacuum(std::vector<std::shared_ptr<pq> > &ordered) {
 
 }
 
+// the number of ways a string of bosonic operators can be fully contracted
+static int count_boson_contractions(std::vector<bool> is_dagger) {
+
+    if ( is_dagger.size() == 0 ) return 1;
+
+    // the leftmost creator must be contracted with an annihilator to its left
+    int right = -1;
+    for (int i = 0; i < (int)is_dagger.size(); i++) {
+        if ( is_dagger[i] ) {
+            right = i;
+            break;
+        }
+    }
+    if ( right < 1 ) return 0;
+
+    int n_contractions = 0;
+    for (int left = right - 1; left >= 0; left--) {
+        std::vector<bool> remaining;
+        for (int i = 0; i < (int)is_dagger.size(); i++) {
+            if ( i == left || i == right ) continue;
+            remaining.push_back(is_dagger[i]);
+        }
+        n_contractions += count_boson_contractions(remaining);
+    }
+    return n_contractions;
+}
+
+// enumerate fully-contracted terms directly, rather than by repeated calls to 
+// normal_order_fermi_vacuum. the terms (and their order) are the same as those 
+// that survive cleanup when the string is brought to normal order, but no
+// partially-contracted strings are ever built.
+void pq::fully_contract(std::vector<std::shared_ptr<pq> > &ordered) {
+
+    if ( skip ) return;
+
+    // each full contraction of the bosonic operators gives an identical term
+    int n_boson_contractions = count_boson_contractions(data->is_boson_dagger);
+    if ( n_boson_contractions == 0 ) return;
+
+    // there must be as many quasi-creators as quasi-annihilators
+    int n_creators = 0;
+    for (int i = 0; i < (int)symbol.size(); i++) {
+        if ( is_dagger_fermi[i] ) n_creators++;
+    }
+    if ( 2 * n_creators != (int)symbol.size() ) return;
+
+    std::vector<int> remaining;
+    for (int i = 0; i < (int)symbol.size(); i++) {
+        remaining.push_back(i);
+    }
+    std::vector<int> contractions;
+    contract_remaining_operators(remaining, sign, contractions, n_boson_contractions, ordered);
+
+}
+
+// contract the leftmost quasi-creator in "remaining" with each quasi-annihilator 
+// to its left, nearest first, which is the order in which the pairwise 
+// rewrites in normal_order_fermi_vacuum generate them.
+void pq::contract_remaining_operators(std::vector<int> & remaining, int my_sign, std::vector<int> & contractions,
+                                      int multiplicity, std::vector<std::shared_ptr<pq> > &ordered) {
+
+    // everything is contracted
+    if ( remaining.size() == 0 ) {
+
+        // when only connected terms are wanted, every cluster operator (vertex > 0)
+        // must be contracted with the first vertex
+        if ( data->vertex.size() > 0 ) {
+            std::vector<bool> is_connected(symbol.size() + 1, false);
+            is_connected[0] = true;
+            for (int i = 0; i < (int)contractions.size(); i += 2) {
+                int left_vertex  = data->vertex[contractions[i]];
+                int right_vertex = data->vertex[contractions[i+1]];
+                if ( left_vertex == 0 && right_vertex > 0 ) is_connected[right_vertex] = true;
+                if ( right_vertex == 0 && left_vertex > 0 ) is_connected[left_vertex] = true;
+            }
+            for (int i = 0; i < (int)data->vertex.size(); i++) {
+                if ( data->vertex[i] > 0 && !is_connected[data->vertex[i]] ) return;
+            }
+        }
+
+        std::shared_ptr<pq> newguy = new_string();
+        newguy->shallow_copy((void*)this);
+        newguy->sign = my_sign;
+        newguy->data->factor *= multiplicity;
+        for (int i = 0; i < (int)contractions.size(); i += 2) {
+            newguy->delta1.push_back(symbol[contractions[i]]);
+            newguy->delta2.push_back(symbol[contractions[i+1]]);
+        }
+        ordered.push_back(newguy);
+        return;
+    }
+
+    // a quasi-annihilator on the right vanishes against the vacuum
+    if ( !is_dagger_fermi[remaining.back()] ) return;
+
+    int right = -1;
+    for (int i = 0; i < (int)remaining.size(); i++) {
+        if ( is_dagger_fermi[remaining[i]] ) {
+            right = i;
+            break;
+        }
+    }
+
+    // as does a quasi-creator on the left
+    if ( right < 1 ) return;
+
+    for (int left = right - 1; left >= 0; left--) {
+
+        // operators with the same dagger just anticommute
+        if ( is_dagger[remaining[left]] == is_dagger[remaining[right]] ) continue;
+
+        // the quasi-creator passes (right - left - 1) operators on its way to this one
+        int new_sign = my_sign;
+        if ( (right - left - 1) % 2 != 0 ) new_sign = -new_sign;
+
+        std::vector<int> new_remaining;
+        for (int i = 0; i < (int)remaining.size(); i++) {
+            if ( i == left || i == right ) continue;
+            new_remaining.push_back(remaining[i]);
+        }
+
+        contractions.push_back(remaining[left]);
+        contractions.push_back(remaining[right]);
+
+        contract_remaining_operators(new_remaining, new_sign, contractions, multiplicity, ordered);
+
+        contractions.pop_back();
+        contractions.pop_back();
+    }
+
+}
+
 bool pq::normal_order(std::vector<std::shared_ptr<pq> > &ordered) {
-    if ( vacuum == "TRUE" ) {
-        return normal_order_true_vacuum(ordered);
-    }else {
+    if ( fermi_vacuum ) {
         return normal_order_fermi_vacuum(ordered);
+    }else {
+        return normal_order_true_vacuum(ordered);
     }
 }
 
@@ -3061,8 +3739,8 @@ void pq::reclassify_tensors() {
     if ( data->tensor_type == "OCC_REPULSION") {
 
         // pick summation label not included in string already
-        std::vector<std::string> occ_out{"i","j","k","l","i0","i1","i2","i3","i4","i5","i6","i7","i8","i9"};
-        std::string idx;
+        static const std::vector<label> occ_out{"i","j","k","l","i0","i1","i2","i3","i4","i5","i6","i7","i8","i9"};
+        label idx;
 
         int skip = -999;
 
@@ -3080,8 +3758,8 @@ void pq::reclassify_tensors() {
             exit(1);
         }
 
-        std::string idx1 = data->tensor[0];
-        std::string idx2 = data->tensor[1];
+        label idx1 = data->tensor[0];
+        label idx2 = data->tensor[1];
 
         data->tensor.clear();
 
@@ -25,71 +25,83 @@
 #ifndef SQE_H
 #define SQE_H
 
+#include<unordered_map>
+
 #include "data.h"
+#include "operator_flags.h"
+#include "pq_pool.h"
 
 namespace pdaggerq {
 
+class thread_pool;
+
 class pq {
 
   private:
 
-    /// is the entire string (fermions+bosons) in normal order?
-    bool is_normal_order();
+    /// is the entire string (fermions+bosons) in normal order? (relative to the fermi vacuum, if fermi)
+    template <bool fermi> bool is_normal_order();
 
     /// are bosonic operators in normal order?
     bool is_boson_normal_order();
 
     /// is label "idx" present anywhere?
-    bool index_in_anywhere(std::string idx);
+    bool index_in_anywhere(label idx);
 
     /// is label "idx" present in tensor term?
-    bool index_in_tensor(std::string idx);
+    bool index_in_tensor(label idx);
 
     /// is label "idx" present in t-amplitudes?
-    bool index_in_t_amplitudes(std::string idx);
+    bool index_in_t_amplitudes(label idx);
 
     /// is label "idx" present in u-amplitudes?
-    bool index_in_u_amplitudes(std::string idx);
+    bool index_in_u_amplitudes(label idx);
 
     /// is label "idx" present in m-amplitudes?
-    bool index_in_m_amplitudes(std::string idx);
+    bool index_in_m_amplitudes(label idx);
 
     /// is label "idx" present in s-amplitudes?
-    bool index_in_s_amplitudes(std::string idx);
+    bool index_in_s_amplitudes(label idx);
 
     /// is label "idx" present in left-hand amplitudes?
-    bool index_in_left_amplitudes(std::string idx);
+    bool index_in_left_amplitudes(label idx);
 
     /// is label "idx" present in right-hand amplitudes?
-    bool index_in_right_amplitudes(std::string idx);
+    bool index_in_right_amplitudes(label idx);
 
     /// replace one label with another (everywhere)
-    void replace_index_everywhere(std::string old_idx, std::string new_idx);
+    void replace_index_everywhere(label old_idx, label new_idx);
 
     /// replace one label with another (in tensor)
-    void replace_index_in_tensor(std::string old_idx, std::string new_idx);
+    void replace_index_in_tensor(label old_idx, label new_idx);
 
     /// replace one label with another (in t-amplitudes)
-    void replace_index_in_t_amplitudes(std::string old_idx, std::string new_idx);
+    void replace_index_in_t_amplitudes(label old_idx, label new_idx);
 
     /// replace one label with another (in u-amplitudes)
-    void replace_index_in_u_amplitudes(std::string old_idx, std::string new_idx);
+    void replace_index_in_u_amplitudes(label old_idx, label new_idx);
 
     /// replace one label with another (in m-amplitudes)
-    void replace_index_in_m_amplitudes(std::string old_idx, std::string new_idx);
+    void replace_index_in_m_amplitudes(label old_idx, label new_idx);
 
     /// replace one label with another (in s-amplitudes)
-    void replace_index_in_s_amplitudes(std::string old_idx, std::string new_idx);
+    void replace_index_in_s_amplitudes(label old_idx, label new_idx);
 
     /// replace one label with another (in left-hand amplitudes)
-    void replace_index_in_left_amplitudes(std::string old_idx, std::string new_idx);
+    void replace_index_in_left_amplitudes(label old_idx, label new_idx);
 
     /// replace one label with another (in right-hand amplitudes)
-    void replace_index_in_right_amplitudes(std::string old_idx, std::string new_idx);
+    void replace_index_in_right_amplitudes(label old_idx, label new_idx);
 
     /// are two strings the same? if so, how many permutations to relate them?
     bool compare_strings(std::shared_ptr<pq> ordered_1, std::shared_ptr<pq> ordered_2, int & n_permute);
 
+    /// key shared by any strings that compare_strings might consider the same
+    std::string comparison_key();
+
+    /// relabel summation indices so that equivalent fully-contracted strings are identical. returns a key for comparing them
+    std::string canonicalize(bool real_orbitals);
+
     /// prioritize summation labels as i > j > k > l and a > b > c > d.
     void update_summation_labels();
 
@@ -97,7 +109,11 @@ class pq {
     void update_bra_labels();
 
     /// swap to labels
-    void swap_two_labels(std::string label1, std::string label2);
+    void swap_two_labels(label label1, label label2);
+
+    /// recursively pair up the remaining operators (see fully_contract)
+    void contract_remaining_operators(std::vector<int> & remaining, int my_sign, std::vector<int> & contractions,
+                                      int multiplicity, std::vector<std::shared_ptr<pq> > &ordered);
 
   public:
 
@@ -110,12 +126,27 @@ class pq {
     /// vacuum type (fermi, true)
     std::string vacuum;
 
+    /// is vacuum the fermi vacuum? (so per-string work doesn't compare strings)
+    bool fermi_vacuum;
+
     /// do skip because will evaluate to zero?
     bool skip     = false;
 
     /// sign
     int sign      = 1;
 
+    /// have delta functions been applied and labels made conventional? (see pq_helper::simplify_strings)
+    bool simplified = false;
+
+    /// pool that handed out this string (null if allocated directly)
+    pq_pool * pool = nullptr;
+
+    /// new empty string, drawn from the same pool as this one
+    std::shared_ptr<pq> new_string();
+
+    /// reset to an empty string, keeping any storage already allocated
+    void reset(std::string vacuum_type);
+
     /// copy all data, except symbols and daggers. 
     void shallow_copy(void * copy_me);
 
@@ -123,19 +154,19 @@ class pq {
     void copy(void * copy_me);
 
     /// list: symbols for fermionic creation / annihilation operators
-    std::vector<std::string> symbol;
+    std::vector<label> symbol;
 
     /// list: is fermionic operator creator or annihilator (relative to true vacuum)?
-    std::vector<bool> is_dagger;
+    operator_flags is_dagger;
 
     /// list: is fermionic operator creator or annihilator (relative to fermi vacuum)?
-    std::vector<bool> is_dagger_fermi;
+    operator_flags is_dagger_fermi;
 
     /// list of delta functions (index 1)
-    std::vector<std::string> delta1;
+    std::vector<label> delta1;
 
     /// list of delta functions (index 2)
-    std::vector<std::string> delta2;
+    std::vector<label> delta2;
 
     /// detailed information about string (t, R, L, amplitudes, bosons, etc.)
     std::shared_ptr<StringData> data;
@@ -152,6 +183,9 @@ class pq {
     /// check if string should be zero by o/v labels in delta function
     void check_occ_vir();
 
+    /// check if string should be zero because it has no fully-contracted terms (fermi vacuum)
+    void check_contractible();
+
     /// apply delta functions to string / tensor labels
     void gobble_deltas();
 
@@ -167,20 +201,33 @@ class pq {
     /// bring string to normal order relative to true vacuum
     bool normal_order_true_vacuum(std::vector<std::shared_ptr<pq> > &ordered);
 
+    /// generate only the fully-contracted terms (fermi vacuum)
+    void fully_contract(std::vector<std::shared_ptr<pq> > &ordered);
+
     /// alphabetize operators to simplify string comparisons
     void alphabetize(std::vector<std::shared_ptr<pq> > &ordered);
 
-    /// cancel terms where appropriate
-    void cleanup(std::vector<std::shared_ptr<pq> > &ordered);
+    /// cancel terms where appropriate. returns the number of string comparisons made. 
+    /// with use_canonical_labels, fully-contracted strings (fermi vacuum) are put in 
+    /// canonical form and merged without pairwise comparisons. with real_orbitals, the 
+    /// canonical form also uses symmetries that hold only for real orbitals. work is 
+    /// spread over threads, if given; the results do not depend on the number of threads
+    long int cleanup(std::vector<std::shared_ptr<pq> > &ordered, bool use_canonical_labels = false, bool real_orbitals = false, thread_pool * threads = nullptr);
+
+    /// put fully-contracted strings (fermi vacuum) in canonical form and merge them into a list 
+    /// of distinct strings. index maps the canonical form of each string in merged to its 
+    /// position there. other strings in in are dropped, and in is emptied
+    void merge_canonical(std::vector<std::shared_ptr<pq> > &in, std::vector<std::shared_ptr<pq> > &merged, 
+                         std::unordered_map<std::string, int> &index, bool real_orbitals, thread_pool * threads = nullptr);
 
     /// reorder t amplitudes as t1, t2, t3
     void reorder_t_amplitudes();
 
     /// does label correspond to occupied orbital?
-    bool is_occ(std::string idx);
+    bool is_occ(label idx);
 
     /// does label correspond to virtual orbital?
-    bool is_vir(std::string idx);
+    bool is_vir(label idx);
 
     /// re-classify fluctuation potential terms
     void reclassify_tensors();
@@ -0,0 +1,438 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: pq_cli.cc
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+// a command-line driver for pdaggerq. reads a list of commands (one per line)
+// from a file or from standard input and applies them to a pq_helper. the
+// commands mirror the python api, e.g.,
+//
+//     vacuum fermi
+//     set_left_operators [e2(m,n,f,e)]
+//     add_st_operator 1.0 [f] [t1,t2]
+//     add_st_operator 1.0 [v] [t1,t2]
+//     simplify
+//     print_fully_contracted
+//     clear
+//
+// lists are enclosed in square brackets. psi4-style input, like input.dat, 
+// (set sqfactor / sqtensor / sqstring, followed by energy('pdaggerq')) is 
+// also understood.
+
+#include<memory>
+#include<vector>
+#include<string>
+#include<map>
+#include<iostream>
+#include<fstream>
+#include<sstream>
+#include<cstdio>
+#include<cstdlib>
+
+#include "pq_helper.h"
+
+using namespace pdaggerq;
+
+static void error(int line_number, std::string message) {
+    printf("\n");
+    printf("    error (line %i): %s\n",line_number,message.c_str());
+    printf("\n");
+    exit(1);
+}
+
+// split a line into arguments, keeping bracketed lists together
+static std::vector<std::string> split_line(std::string line, int line_number) {
+
+    std::vector<std::string> args;
+    std::string current;
+    int depth = 0;
+    for (int i = 0; i < (int)line.size(); i++) {
+        char c = line[i];
+        if ( c == '[' ) depth++;
+        if ( c == ']' ) depth--;
+        if ( depth < 0 ) error(line_number, "unbalanced brackets");
+        if ( depth == 0 && ( c == ' ' || c == '\t' ) ) {
+            if ( !current.empty() ) args.push_back(current);
+            current.clear();
+            continue;
+        }
+        current += c;
+    }
+    if ( depth != 0 ) error(line_number, "unbalanced brackets");
+    if ( !current.empty() ) args.push_back(current);
+
+    return args;
+}
+
+// parse a bracketed list, e.g., [e2(m,n,f,e),t1]. commas inside parentheses 
+// belong to the operator
+static std::vector<std::string> parse_list(std::string arg, int line_number) {
+
+    if ( arg.size() < 2 || arg.front() != '[' || arg.back() != ']' ) {
+        error(line_number, "expected a list in square brackets (" + arg + ")");
+    }
+
+    std::vector<std::string> list;
+    std::string current;
+    int depth = 0;
+    for (int i = 1; i < (int)arg.size() - 1; i++) {
+        char c = arg[i];
+        if ( c == '(' ) depth++;
+        if ( c == ')' ) depth--;
+        if ( c == ' ' || c == '\t' || c == '\'' || c == '"' ) continue;
+        if ( depth == 0 && c == ',' ) {
+            list.push_back(current);
+            current.clear();
+            continue;
+        }
+        current += c;
+    }
+    if ( !current.empty() ) list.push_back(current);
+
+    return list;
+}
+
+static double parse_number(std::string arg, int line_number) {
+
+    // allow simple fractions like 1.0/6.0
+    size_t slash = arg.find('/');
+    char * end;
+    if ( slash != std::string::npos ) {
+        double num = strtod(arg.substr(0, slash).c_str(), &end);
+        if ( *end != '\0' ) error(line_number, "invalid number (" + arg + ")");
+        double den = strtod(arg.substr(slash + 1).c_str(), &end);
+        if ( *end != '\0' ) error(line_number, "invalid number (" + arg + ")");
+        return num / den;
+    }
+
+    double value = strtod(arg.c_str(), &end);
+    if ( *end != '\0' || arg.empty() ) error(line_number, "invalid number (" + arg + ")");
+    return value;
+}
+
+static bool parse_bool(std::string arg, int line_number) {
+    if ( arg == "true" || arg == "True" || arg == "1" ) return true;
+    if ( arg == "false" || arg == "False" || arg == "0" ) return false;
+    error(line_number, "invalid boolean (" + arg + ")");
+    return false;
+}
+
+static void print_stats(pq_helper & pq) {
+
+    pq_stats stats = pq.get_stats();
+
+    printf("\n");
+    printf("    // timings (s):\n");
+    printf("    //     expand:          %10.3f\n",stats.expand_time);
+    printf("    //     normal order:    %10.3f\n",stats.normal_order_time);
+    printf("    //     gobble deltas:   %10.3f\n",stats.gobble_deltas_time);
+    printf("    //     relabel:         %10.3f\n",stats.relabel_time);
+    printf("    //     cleanup:         %10.3f\n",stats.cleanup_time);
+    printf("    // strings created:     %10li\n",stats.strings_created);
+    printf("    // peak strings:        %10li\n",stats.peak_strings);
+    printf("    // string comparisons:  %10li\n",stats.compare_calls);
+    printf("    // normal-ordering passes (created / pruned):\n");
+    for (int i = 0; i < (int)stats.created_per_pass.size(); i++) {
+        printf("    //     %5i %10li %10li\n",i,stats.created_per_pass[i],stats.pruned_per_pass[i]);
+    }
+    printf("\n");
+}
+
+// strings, tensors, and factors from psi4-style input, by suffix ("", "2", "3", ...)
+struct legacy_strings {
+    std::map<int, double> factor;
+    std::map<int, std::vector<std::string> > tensor;
+    std::map<int, std::vector<std::string> > string;
+};
+
+static void run(std::istream & input) {
+
+    std::shared_ptr<pq_helper> pq;
+    legacy_strings legacy;
+
+    // vacuum defaults to the true vacuum unless set before the first other command
+    auto helper = [&]() -> pq_helper & {
+        if ( !pq ) pq = (std::shared_ptr<pq_helper>)(new pq_helper(""));
+        return *pq;
+    };
+
+    std::string line;
+    int line_number = 0;
+    while ( std::getline(input, line) ) {
+
+        line_number++;
+
+        size_t comment = line.find('#');
+        if ( comment != std::string::npos ) line = line.substr(0, comment);
+
+        std::vector<std::string> args = split_line(line, line_number);
+        if ( args.empty() ) continue;
+
+        std::string cmd = args[0];
+        int n_args = (int)args.size() - 1;
+
+        auto expect = [&](int n) {
+            if ( n_args != n ) {
+                error(line_number, cmd + " expects " + std::to_string(n) + " argument(s)");
+            }
+        };
+
+        // python boilerplate in psi4-style input
+        if ( cmd == "import" || cmd.compare(0, 4, "sys.") == 0 ) continue;
+
+        if ( cmd == "vacuum" ) {
+            expect(1);
+            if ( pq ) error(line_number, "vacuum must be set before any other command");
+            pq = (std::shared_ptr<pq_helper>)(new pq_helper(args[1]));
+        }else if ( cmd == "set" ) {
+
+            // psi4-style input: set sqfactor[n] / sqtensor[n] / sqstring[n]
+            expect(2);
+            std::string key = args[1];
+            std::string prefix;
+            if ( key.compare(0, 8, "sqfactor") == 0 ) {
+                prefix = "sqfactor";
+            }else if ( key.compare(0, 8, "sqtensor") == 0 ) {
+                prefix = "sqtensor";
+            }else if ( key.compare(0, 8, "sqstring") == 0 ) {
+                prefix = "sqstring";
+            }else {
+                error(line_number, "unknown option (" + key + ")");
+            }
+            std::string suffix = key.substr(prefix.size());
+            int n = suffix.empty() ? 1 : atoi(suffix.c_str());
+            if ( prefix == "sqfactor" ) {
+                legacy.factor[n] = parse_number(args[2], line_number);
+            }else if ( prefix == "sqtensor" ) {
+                legacy.tensor[n] = parse_list(args[2], line_number);
+            }else {
+                legacy.string[n] = parse_list(args[2], line_number);
+            }
+        }else if ( cmd.compare(0, 7, "energy(") == 0 ) {
+
+            // psi4-style input: add, simplify, and print the strings set so far
+            for (auto it = legacy.string.begin(); it != legacy.string.end(); it++) {
+                int n = it->first;
+                helper().set_string(it->second);
+                if ( legacy.tensor.count(n) ) {
+                    std::vector<std::string> & tensor = legacy.tensor[n];
+                    helper().set_tensor(tensor, tensor.size() == 4 ? "TWO_BODY" : "CORE");
+                }
+                helper().set_factor(legacy.factor.count(n) ? legacy.factor[n] : 1.0);
+                helper().add_new_string();
+            }
+            legacy = legacy_strings();
+            helper().simplify();
+            helper().print();
+            helper().clear();
+
+        }else if ( cmd == "set_print_level" ) {
+            expect(1);
+            helper().set_print_level(atoi(args[1].c_str()));
+        }else if ( cmd == "set_num_threads" ) {
+            expect(1);
+            helper().set_num_threads(atoi(args[1].c_str()));
+        }else if ( cmd == "set_use_wick_enumerator" ) {
+            expect(1);
+            helper().set_use_wick_enumerator(parse_bool(args[1], line_number));
+        }else if ( cmd == "set_connected_only" ) {
+            expect(1);
+            helper().set_connected_only(parse_bool(args[1], line_number));
+        }else if ( cmd == "set_use_canonical_labels" ) {
+            expect(1);
+            helper().set_use_canonical_labels(parse_bool(args[1], line_number));
+        }else if ( cmd == "set_real_orbitals" ) {
+            expect(1);
+            helper().set_real_orbitals(parse_bool(args[1], line_number));
+        }else if ( cmd == "set_incremental_simplify" ) {
+            expect(1);
+            helper().set_incremental_simplify(parse_bool(args[1], line_number));
+        }else if ( cmd == "set_collect_stats" ) {
+            expect(1);
+            helper().set_collect_stats(parse_bool(args[1], line_number));
+        }else if ( cmd == "set_cache_dir" ) {
+            if ( n_args > 1 ) expect(1);
+            helper().set_cache_dir(n_args == 1 ? args[1] : "");
+        }else if ( cmd == "set_bra" ) {
+            if ( n_args > 1 ) expect(1);
+            helper().set_bra(n_args == 1 ? args[1] : "");
+        }else if ( cmd == "set_ket" ) {
+            if ( n_args > 1 ) expect(1);
+            helper().set_ket(n_args == 1 ? args[1] : "");
+        }else if ( cmd == "set_left_operators" ) {
+            expect(1);
+            helper().set_left_operators(parse_list(args[1], line_number));
+        }else if ( cmd == "set_right_operators" ) {
+            expect(1);
+            helper().set_right_operators(parse_list(args[1], line_number));
+        }else if ( cmd == "set_string" ) {
+            expect(1);
+            helper().set_string(parse_list(args[1], line_number));
+        }else if ( cmd == "set_tensor" ) {
+            expect(2);
+            helper().set_tensor(parse_list(args[1], line_number), args[2]);
+        }else if ( cmd == "set_t_amplitudes" ) {
+            expect(1);
+            helper().set_t_amplitudes(parse_list(args[1], line_number));
+        }else if ( cmd == "set_u_amplitudes" ) {
+            expect(1);
+            helper().set_u_amplitudes(parse_list(args[1], line_number));
+        }else if ( cmd == "set_m_amplitudes" ) {
+            expect(1);
+            helper().set_m_amplitudes(parse_list(args[1], line_number));
+        }else if ( cmd == "set_s_amplitudes" ) {
+            expect(1);
+            helper().set_s_amplitudes(parse_list(args[1], line_number));
+        }else if ( cmd == "set_left_amplitudes" ) {
+            expect(1);
+            helper().set_left_amplitudes(parse_list(args[1], line_number));
+        }else if ( cmd == "set_right_amplitudes" ) {
+            expect(1);
+            helper().set_right_amplitudes(parse_list(args[1], line_number));
+        }else if ( cmd == "set_factor" ) {
+            expect(1);
+            helper().set_factor(parse_number(args[1], line_number));
+        }else if ( cmd == "add_new_string" ) {
+            expect(0);
+            helper().add_new_string();
+        }else if ( cmd == "add_operator_product" ) {
+            expect(2);
+            helper().add_operator_product(parse_number(args[1], line_number), parse_list(args[2], line_number));
+        }else if ( cmd == "add_st_operator" ) {
+            expect(3);
+            helper().add_st_operator(parse_number(args[1], line_number), parse_list(args[2], line_number),
+                                                                         parse_list(args[3], line_number));
+        }else if ( cmd == "add_commutator" || cmd == "add_double_commutator" 
+                || cmd == "add_triple_commutator" || cmd == "add_quadruple_commutator" ) {
+
+            int n_ops = 2;
+            if ( cmd == "add_double_commutator" )    n_ops = 3;
+            if ( cmd == "add_triple_commutator" )    n_ops = 4;
+            if ( cmd == "add_quadruple_commutator" ) n_ops = 5;
+            expect(n_ops + 1);
+
+            double factor = parse_number(args[1], line_number);
+            std::vector<std::vector<std::string> > ops;
+            for (int i = 0; i < n_ops; i++) {
+                ops.push_back(parse_list(args[i + 2], line_number));
+            }
+
+            if ( n_ops == 2 ) {
+                helper().add_commutator(factor, ops[0], ops[1]);
+            }else if ( n_ops == 3 ) {
+                helper().add_double_commutator(factor, ops[0], ops[1], ops[2]);
+            }else if ( n_ops == 4 ) {
+                helper().add_triple_commutator(factor, ops[0], ops[1], ops[2], ops[3]);
+            }else {
+                helper().add_quadruple_commutator(factor, ops[0], ops[1], ops[2], ops[3], ops[4]);
+            }
+
+        }else if ( cmd == "simplify" ) {
+            expect(0);
+            helper().simplify();
+        }else if ( cmd == "clear" ) {
+            expect(0);
+            helper().clear();
+        }else if ( cmd == "save" ) {
+            expect(1);
+            helper().save(args[1]);
+        }else if ( cmd == "load" ) {
+            expect(1);
+            helper().load(args[1]);
+        }else if ( cmd == "print" ) {
+            expect(0);
+            helper().print();
+        }else if ( cmd == "print_fully_contracted" ) {
+            expect(0);
+            helper().print_fully_contracted();
+        }else if ( cmd == "print_one_body" ) {
+            expect(0);
+            helper().print_one_body();
+        }else if ( cmd == "print_two_body" ) {
+            expect(0);
+            helper().print_two_body();
+        }else if ( cmd == "set_dimension_estimates" ) {
+            expect(2);
+            helper().set_dimension_estimates(parse_number(args[1], line_number), parse_number(args[2], line_number));
+        }else if ( cmd == "print_contraction_paths" ) {
+            expect(0);
+            helper().print_contraction_paths();
+        }else if ( cmd == "print_einsum_function" ) {
+            if ( n_args != 1 && n_args != 2 ) {
+                error(line_number, cmd + " expects 1 or 2 argument(s)");
+            }
+            std::vector<std::string> output_labels;
+            if ( n_args == 2 ) output_labels = parse_list(args[2], line_number);
+            printf("%s", helper().einsum_function(args[1], output_labels).c_str());
+        }else if ( cmd == "print_cpp_function" ) {
+            // print_cpp_function name [labels] [gemm | loops]
+            if ( n_args < 1 || n_args > 3 ) {
+                error(line_number, cmd + " expects 1 to 3 argument(s)");
+            }
+            std::vector<std::string> output_labels;
+            bool use_gemm = true;
+            for (int i = 2; i <= n_args; i++) {
+                if ( args[i] == "gemm" || args[i] == "loops" ) {
+                    use_gemm = ( args[i] == "gemm" );
+                }else {
+                    output_labels = parse_list(args[i], line_number);
+                }
+            }
+            printf("%s", helper().cpp_function(args[1], output_labels, use_gemm).c_str());
+        }else if ( cmd == "print_stats" ) {
+            expect(0);
+            print_stats(helper());
+        }else if ( cmd == "reset_stats" ) {
+            expect(0);
+            helper().reset_stats();
+        }else {
+            error(line_number, "unknown command (" + cmd + ")");
+        }
+    }
+}
+
+int main(int argc, char * argv[]) {
+
+    if ( argc > 2 ) {
+        printf("\n");
+        printf("    usage: %s [input file]\n",argv[0]);
+        printf("\n");
+        return 1;
+    }
+
+    if ( argc == 1 ) {
+        run(std::cin);
+        return 0;
+    }
+
+    std::ifstream input(argv[1]);
+    if ( !input.is_open() ) {
+        printf("\n");
+        printf("    error: could not open %s\n",argv[1]);
+        printf("\n");
+        return 1;
+    }
+    run(input);
+
+    return 0;
+}
@@ -0,0 +1,882 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: pq_codegen.cc
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include<memory>
+#include<vector>
+#include<string>
+#include<algorithm>
+#include<cmath>
+#include<cctype>
+#include<cstdio>
+#include<cstdlib>
+
+#include "pq_codegen.h"
+
+namespace pdaggerq {
+
+/// an array that appears in a term, along with its labels
+struct term_operand {
+
+    /// name of the argument that holds the array
+    std::string argument;
+
+    /// array as it is passed to einsum (e.g., g[o, o, v, v])
+    std::string array;
+
+    /// does the array span all orbitals (integrals, delta functions) or is it blocked (amplitudes)?
+    bool sliced;
+
+    /// labels for each axis
+    std::vector<label> labels;
+
+};
+
+/// a fully-contracted string as a product of a factor, scalars, and a contraction of arrays
+struct codegen_term {
+
+    /// factor, including sign
+    double factor;
+
+    /// scalars (l0, r0, ...)
+    std::vector<std::string> scalars;
+
+    /// arrays to contract
+    std::vector<term_operand> operands;
+
+    /// the string, as from pq::get_string
+    std::vector<std::string> string;
+
+    /// the string as pdaggerq prints it
+    std::string comment;
+
+};
+
+/// letters available for einsum subscripts
+static const std::string einsum_letters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+static void codegen_error(std::string message) {
+    printf("\n");
+    printf("    error: %s\n", message.c_str());
+    printf("\n");
+    exit(1);
+}
+
+/// slice of the orbitals spanned by a label
+static std::string label_slice(const label & idx) {
+    if ( idx.is_occ() ) return "o";
+    if ( idx.is_vir() ) return "v";
+    return ":";
+}
+
+/// an integral (or delta function), sliced according to its labels
+static term_operand integral_operand(std::string argument, const std::vector<label> & labels) {
+    term_operand me;
+    me.argument = argument;
+    me.labels   = labels;
+    me.sliced   = true;
+    me.array    = argument + "[";
+    for (int i = 0; i < (int)labels.size(); i++) {
+        if ( i > 0 ) me.array += ", ";
+        me.array += label_slice(labels[i]);
+    }
+    me.array += "]";
+    return me;
+}
+
+/// an amplitude (t1, t2, l1, ...), which is passed already blocked
+static term_operand amplitude_operand(std::string prefix, const std::vector<label> & labels) {
+    term_operand me;
+    me.argument = prefix + std::to_string(labels.size() / 2);
+    me.array    = me.argument;
+    me.labels   = labels;
+    me.sliced   = false;
+    return me;
+}
+
+/// name of the argument that holds integrals of a given type
+static std::string integral_argument(const std::string & tensor_type) {
+    if ( tensor_type == "FOCK" )     return "f";
+    if ( tensor_type == "CORE" )     return "h";
+    if ( tensor_type == "ERI" )      return "g";
+    if ( tensor_type == "TWO_BODY" ) return "tei";
+    if ( tensor_type == "D+" || tensor_type == "D-" ) return "d";
+    codegen_error("no array for tensor type " + tensor_type);
+    return "";
+}
+
+static codegen_term make_term(const std::shared_ptr<pq> & in) {
+
+    codegen_term term;
+    term.factor = in->sign * in->data->factor.value();
+
+    term.string = in->get_string();
+    for (int i = 0; i < (int)term.string.size(); i++) {
+        if ( i > 0 ) term.comment += " ";
+        term.comment += term.string[i];
+    }
+
+    for (int i = 0; i < (int)in->delta1.size(); i++) {
+        std::vector<label> labels = {in->delta1[i], in->delta2[i]};
+        term.operands.push_back(integral_operand("kd", labels));
+    }
+    if ( !in->data->tensor.empty() ) {
+        term.operands.push_back(integral_operand(integral_argument(in->data->tensor_type), in->data->tensor));
+    }
+
+    const std::vector<std::pair<std::string, std::vector<std::vector<label> > *> > amplitudes = {
+        {"l", &in->data->left_amplitudes},
+        {"r", &in->data->right_amplitudes},
+        {"t", &in->data->t_amplitudes},
+        {"u", &in->data->u_amplitudes},
+        {"m", &in->data->m_amplitudes},
+        {"s", &in->data->s_amplitudes}};
+    for (int i = 0; i < (int)amplitudes.size(); i++) {
+        for (int j = 0; j < (int)amplitudes[i].second->size(); j++) {
+            const std::vector<label> & labels = amplitudes[i].second->at(j);
+            if ( labels.empty() ) continue;
+            term.operands.push_back(amplitude_operand(amplitudes[i].first, labels));
+        }
+    }
+
+    if ( in->data->has_l0 ) term.scalars.push_back("l0");
+    if ( in->data->has_r0 ) term.scalars.push_back("r0");
+    if ( in->data->has_u0 ) term.scalars.push_back("u0");
+    if ( in->data->has_m0 ) term.scalars.push_back("m0");
+    if ( in->data->has_s0 ) term.scalars.push_back("s0");
+    if ( in->data->has_w0 ) term.scalars.push_back("w0");
+
+    return term;
+}
+
+/// labels that appear exactly once in a term, in order of first appearance
+static std::vector<label> external_labels(const codegen_term & term) {
+
+    std::vector<label> labels;
+    std::vector<int> count;
+    for (int i = 0; i < (int)term.operands.size(); i++) {
+        for (int j = 0; j < (int)term.operands[i].labels.size(); j++) {
+            const label & idx = term.operands[i].labels[j];
+            int k = (int)(std::find(labels.begin(), labels.end(), idx) - labels.begin());
+            if ( k == (int)labels.size() ) {
+                labels.push_back(idx);
+                count.push_back(0);
+            }
+            count[k]++;
+        }
+    }
+
+    std::vector<label> externals;
+    for (int i = 0; i < (int)labels.size(); i++) {
+        if ( count[i] == 1 ) externals.push_back(labels[i]);
+    }
+    return externals;
+}
+
+/// virtual labels, then occupied labels, then general ones, each alphabetically
+static bool output_order(const label & a, const label & b) {
+    int class_a = a.is_vir() ? 0 : ( a.is_occ() ? 1 : 2 );
+    int class_b = b.is_vir() ? 0 : ( b.is_occ() ? 1 : 2 );
+    if ( class_a != class_b ) return class_a < class_b;
+    return a.str() < b.str();
+}
+
+/// the cheapest order in which to contract a term's arrays
+static contraction_path term_path(const codegen_term & term, const std::vector<label> & output, double n_occ, double n_vir) {
+    std::vector<std::vector<label> > arrays;
+    for (int i = 0; i < (int)term.operands.size(); i++) {
+        arrays.push_back(term.operands[i].labels);
+    }
+    return optimal_contraction_path(arrays, output, n_occ, n_vir);
+}
+
+/// einsum subscript for a label: the label itself, if it is a single letter that is not 
+/// yet taken, otherwise the first letter that is not yet taken
+static char subscript(const label & idx, std::vector<label> & labels, std::string & letters) {
+
+    for (int i = 0; i < (int)labels.size(); i++) {
+        if ( labels[i] == idx ) return letters[i];
+    }
+
+    char me = 0;
+    if ( idx.length() == 1 && einsum_letters.find(idx.at(0)) != std::string::npos 
+                           && letters.find(idx.at(0)) == std::string::npos ) {
+        me = idx.at(0);
+    }else {
+        for (int i = 0; i < (int)einsum_letters.size(); i++) {
+            if ( letters.find(einsum_letters[i]) == std::string::npos ) {
+                me = einsum_letters[i];
+                break;
+            }
+        }
+    }
+    if ( me == 0 ) {
+        codegen_error("too many labels for einsum");
+    }
+
+    labels.push_back(idx);
+    letters.push_back(me);
+    return me;
+}
+
+/// arguments in the order they appear in generated functions
+static std::vector<std::string> argument_order() {
+    std::vector<std::string> order = {"f", "h", "g", "tei", "d"};
+    const std::string prefixes = "tulrms";
+    for (int i = 0; i < (int)prefixes.size(); i++) {
+        for (int rank = 1; rank <= 8; rank++) {
+            order.push_back(std::string(1, prefixes[i]) + std::to_string(rank));
+        }
+    }
+    const std::vector<std::string> scalars = {"l0", "r0", "u0", "m0", "s0", "w0"};
+    order.insert(order.end(), scalars.begin(), scalars.end());
+    return order;
+}
+
+/// factor (if not one) and scalars that multiply a term's contraction. the sign is left to the caller
+static std::vector<std::string> scalar_factors(const codegen_term & term) {
+
+    std::vector<std::string> factors;
+
+    char buffer[64];
+    if ( fabs(fabs(term.factor) - 1.0) > 1e-12 ) {
+        snprintf(buffer, sizeof(buffer), "%.16g", fabs(term.factor));
+        factors.push_back(buffer);
+    }
+    for (int i = 0; i < (int)term.scalars.size(); i++) {
+        factors.push_back(term.scalars[i]);
+    }
+    return factors;
+}
+
+/// one line of a generated function, which adds a term to the residual
+static std::string einsum_line(const codegen_term & term, const std::vector<label> & output, const contraction_path & path) {
+
+    std::vector<std::string> factors = scalar_factors(term);
+
+    if ( !term.operands.empty() ) {
+
+        std::vector<label> labels;
+        std::string letters;
+        for (int i = 0; i < (int)output.size(); i++) {
+            subscript(output[i], labels, letters);
+        }
+
+        std::string subscripts;
+        std::string arrays;
+        for (int i = 0; i < (int)term.operands.size(); i++) {
+            if ( i > 0 ) subscripts += ",";
+            for (int j = 0; j < (int)term.operands[i].labels.size(); j++) {
+                subscripts += subscript(term.operands[i].labels[j], labels, letters);
+            }
+            arrays += ", " + term.operands[i].array;
+        }
+        subscripts += "->" + letters.substr(0, output.size());
+
+        std::string call = "np.einsum('" + subscripts + "'" + arrays;
+        // the path in numpy's format: positions in a list of arrays from which the two 
+        // contracted arrays are removed and to which their product is appended
+        if ( (int)term.operands.size() > 1 ) {
+            std::vector<int> arrays;
+            for (int i = 0; i < (int)term.operands.size(); i++) {
+                arrays.push_back(i);
+            }
+            call += ", optimize=['einsum_path'";
+            for (int k = 0; k < (int)path.steps.size(); k++) {
+                int left  = (int)(std::find(arrays.begin(), arrays.end(), path.steps[k].left) - arrays.begin());
+                int right = (int)(std::find(arrays.begin(), arrays.end(), path.steps[k].right) - arrays.begin());
+                call += ", (" + std::to_string(std::min(left, right)) + ", " + std::to_string(std::max(left, right)) + ")";
+                arrays.erase(arrays.begin() + std::max(left, right));
+                arrays.erase(arrays.begin() + std::min(left, right));
+                arrays.push_back((int)term.operands.size() + k);
+            }
+            call += "]";
+        }
+        call += ")";
+        factors.push_back(call);
+    }
+
+    if ( factors.empty() ) {
+        factors.push_back("1.0");
+    }
+
+    std::string line = "    residual ";
+    line += term.factor < 0.0 ? "-= " : "+= ";
+    for (int i = 0; i < (int)factors.size(); i++) {
+        if ( i > 0 ) line += " * ";
+        line += factors[i];
+    }
+    return line + "\n";
+}
+
+/// fully-contracted, fermionic strings as terms
+static std::vector<codegen_term> fully_contracted_terms(const std::vector<std::shared_ptr<pq> > & strings) {
+    std::vector<codegen_term> terms;
+    for (int i = 0; i < (int)strings.size(); i++) {
+        if ( strings[i]->skip ) continue;
+        if ( strings[i]->symbol.size() != 0 ) continue;
+        if ( strings[i]->data->is_boson_dagger.size() != 0 ) continue;
+        terms.push_back(make_term(strings[i]));
+    }
+    return terms;
+}
+
+/// labels for the axes of the residual (output_labels, or the sorted external labels 
+/// of the first term). every term must have the same external labels
+static std::vector<label> residual_labels(const std::vector<codegen_term> & terms, std::string name, std::vector<std::string> output_labels) {
+
+    std::vector<label> output;
+    for (int i = 0; i < (int)output_labels.size(); i++) {
+        output.push_back(label(output_labels[i]));
+    }
+    if ( output.empty() && !terms.empty() ) {
+        output = external_labels(terms[0]);
+        std::sort(output.begin(), output.end(), output_order);
+    }
+
+    std::vector<label> sorted_output = output;
+    std::sort(sorted_output.begin(), sorted_output.end(), output_order);
+    if ( std::adjacent_find(sorted_output.begin(), sorted_output.end()) != sorted_output.end() ) {
+        codegen_error("repeated output label in " + name);
+    }
+
+    for (int i = 0; i < (int)terms.size(); i++) {
+        std::vector<label> externals = external_labels(terms[i]);
+        std::sort(externals.begin(), externals.end(), output_order);
+        if ( externals != sorted_output ) {
+            codegen_error("term '" + terms[i].comment + "' in " + name + " does not have the same external labels as the residual");
+        }
+        if ( terms[i].operands.empty() && !output.empty() ) {
+            codegen_error("term '" + terms[i].comment + "' in " + name + " has no arrays");
+        }
+    }
+
+    return output;
+}
+
+/// arrays and scalars that terms need as arguments, in order (delta functions are not arguments)
+static std::vector<std::string> term_arguments(const std::vector<codegen_term> & terms) {
+
+    std::vector<std::string> arguments;
+    for (int i = 0; i < (int)terms.size(); i++) {
+        for (int j = 0; j < (int)terms[i].operands.size(); j++) {
+            arguments.push_back(terms[i].operands[j].argument);
+        }
+        for (int j = 0; j < (int)terms[i].scalars.size(); j++) {
+            arguments.push_back(terms[i].scalars[j]);
+        }
+    }
+
+    std::vector<std::string> order = argument_order();
+    std::vector<std::string> my_arguments;
+    for (int i = 0; i < (int)order.size(); i++) {
+        if ( std::find(arguments.begin(), arguments.end(), order[i]) != arguments.end() ) {
+            my_arguments.push_back(order[i]);
+        }
+    }
+    return my_arguments;
+}
+
+/// do any terms involve delta functions?
+static bool has_deltas(const std::vector<codegen_term> & terms) {
+    for (int i = 0; i < (int)terms.size(); i++) {
+        for (int j = 0; j < (int)terms[i].operands.size(); j++) {
+            if ( terms[i].operands[j].argument == "kd" ) return true;
+        }
+    }
+    return false;
+}
+
+std::string einsum_function(const std::vector<std::shared_ptr<pq> > & strings, std::string name, std::vector<std::string> output_labels, double n_occ, double n_vir) {
+
+    std::vector<codegen_term> terms = fully_contracted_terms(strings);
+
+    // order of the axes of the residual
+    std::vector<label> output = residual_labels(terms, name, output_labels);
+
+    bool need_kd = has_deltas(terms);
+
+    std::vector<std::string> my_arguments = term_arguments(terms);
+    my_arguments.push_back("o");
+    my_arguments.push_back("v");
+
+    std::string code = "def " + name + "(";
+    for (int i = 0; i < (int)my_arguments.size(); i++) {
+        if ( i > 0 ) code += ", ";
+        code += my_arguments[i];
+    }
+    code += "):\n";
+
+    code += "    \"\"\"\n";
+    code += "    " + name + ": " + std::to_string(terms.size()) + " fully-contracted terms\n";
+    code += "\n";
+    code += "    o and v are slices for the occupied and virtual orbitals, e.g., o = slice(0, nocc)\n";
+    code += "    and v = slice(nocc, nmo). integrals (f, h, g, ...) span all orbitals, and g holds\n";
+    code += "    antisymmetrized integrals <pq||rs>. amplitudes are blocked, e.g., t2[a, b, i, j]\n";
+    code += "    \"\"\"\n";
+    code += "\n";
+
+    bool need_nmo = need_kd;
+    for (int i = 0; i < (int)output.size(); i++) {
+        if ( !output[i].is_occ() && !output[i].is_vir() ) need_nmo = true;
+    }
+    if ( need_nmo ) {
+        code += "    nmo = max(o.stop, v.stop)\n";
+    }
+    if ( need_kd ) {
+        code += "    kd = np.eye(nmo)\n";
+    }
+
+    if ( output.empty() ) {
+        code += "    residual = 0.0\n";
+    }else {
+        code += "    residual = np.zeros((";
+        for (int i = 0; i < (int)output.size(); i++) {
+            if ( i > 0 ) code += ", ";
+            if ( output[i].is_occ() ) {
+                code += "o.stop - o.start";
+            }else if ( output[i].is_vir() ) {
+                code += "v.stop - v.start";
+            }else {
+                code += "nmo";
+            }
+        }
+        code += ( output.size() == 1 ) ? ",))\n" : "))\n";
+    }
+    code += "\n";
+
+    for (int i = 0; i < (int)terms.size(); i++) {
+        code += "    # " + terms[i].comment + "\n";
+        code += einsum_line(terms[i], output, term_path(terms[i], output, n_occ, n_vir));
+    }
+    if ( !terms.empty() ) code += "\n";
+
+    code += "    return residual\n";
+
+    return code;
+}
+
+std::string einsum_module(const std::vector<std::string> & functions) {
+
+    std::string code;
+    code += "\"\"\"\n";
+    code += "residuals generated by pdaggerq\n";
+    code += "\"\"\"\n";
+    code += "\n";
+    code += "import numpy as np\n";
+    for (int i = 0; i < (int)functions.size(); i++) {
+        code += "\n\n";
+        code += functions[i];
+    }
+    return code;
+}
+
+/// name of the loop variable for a label in generated c++
+static std::string loop_variable(const label & idx) {
+    std::string me;
+    for (int i = 0; i < (int)idx.length(); i++) {
+        me += isalnum((unsigned char)idx.at(i)) ? idx.at(i) : '_';
+    }
+    return me + "_";
+}
+
+/// number of orbitals spanned by a label (o, v, or n = o + v)
+static std::string label_dim(const label & idx) {
+    if ( idx.is_occ() ) return "o";
+    if ( idx.is_vir() ) return "v";
+    return "n";
+}
+
+/// orbital index for a label (occupied orbitals come first)
+static std::string orbital_index(const label & idx) {
+    if ( idx.is_vir() ) return "(o + " + loop_variable(idx) + ")";
+    return loop_variable(idx);
+}
+
+/// offset of an element in a row-major array. sliced arrays span all orbitals; blocked
+/// ones span only the orbitals of each label
+static std::string array_offset(const std::vector<label> & labels, bool sliced) {
+    if ( labels.empty() ) return "0";
+    std::string me = sliced ? orbital_index(labels[0]) : loop_variable(labels[0]);
+    for (int i = 1; i < (int)labels.size(); i++) {
+        if ( i > 1 ) me = "(" + me + ")";
+        me += "*" + ( sliced ? std::string("n") : label_dim(labels[i]) ) + " + ";
+        me += sliced ? orbital_index(labels[i]) : loop_variable(labels[i]);
+    }
+    return me;
+}
+
+/// number of elements in a blocked array
+static std::string array_size(const std::vector<label> & labels) {
+    if ( labels.empty() ) return "1";
+    std::string me = label_dim(labels[0]);
+    for (int i = 1; i < (int)labels.size(); i++) {
+        me += "*" + label_dim(labels[i]);
+    }
+    return me;
+}
+
+/// an element of an operand in generated c++
+static std::string operand_element(const term_operand & op) {
+    if ( op.argument == "kd" ) {
+        return "(" + orbital_index(op.labels[0]) + " == " + orbital_index(op.labels[1]) + " ? 1.0 : 0.0)";
+    }
+    return op.argument + "[" + array_offset(op.labels, op.sliced) + "]";
+}
+
+/// open a nest of loops over labels, updating the indentation
+static void open_loops(std::string & code, const std::vector<label> & labels, std::string & indent) {
+    for (int i = 0; i < (int)labels.size(); i++) {
+        std::string var = loop_variable(labels[i]);
+        code += indent + "for (long " + var + " = 0; " + var + " < " + label_dim(labels[i]) + "; " + var + "++) {\n";
+        indent += "    ";
+    }
+}
+
+/// close a nest of loops, updating the indentation
+static void close_loops(std::string & code, int n_loops, std::string & indent) {
+    for (int i = 0; i < n_loops; i++) {
+        indent.resize(indent.size() - 4);
+        code += indent + "}\n";
+    }
+}
+
+/// the statement that adds value (times the factor and scalars of a term) to the residual
+static std::string accumulate(const codegen_term & term, const std::vector<label> & output, std::string value) {
+    std::vector<std::string> factors = scalar_factors(term);
+    if ( value != "1.0" || factors.empty() ) {
+        factors.push_back(value);
+    }
+    std::string me = "residual[" + array_offset(output, false) + "] ";
+    me += term.factor < 0.0 ? "-= " : "+= ";
+    for (int i = 0; i < (int)factors.size(); i++) {
+        if ( i > 0 ) me += " * ";
+        me += factors[i];
+    }
+    return me + ";\n";
+}
+
+/// labels that appear in a term but not in the output, in order of first appearance
+static std::vector<label> summed_labels(const codegen_term & term, const std::vector<label> & output) {
+    std::vector<label> summed;
+    for (int i = 0; i < (int)term.operands.size(); i++) {
+        for (int j = 0; j < (int)term.operands[i].labels.size(); j++) {
+            const label & idx = term.operands[i].labels[j];
+            if ( std::find(output.begin(), output.end(), idx) != output.end() ) continue;
+            if ( std::find(summed.begin(), summed.end(), idx) != summed.end() ) continue;
+            summed.push_back(idx);
+        }
+    }
+    return summed;
+}
+
+/// a term as a loop nest: output labels outermost (in the order of the residual's axes), 
+/// summed labels innermost, accumulating into a local sum
+static std::string loop_term(const codegen_term & term, const std::vector<label> & output) {
+
+    std::string code;
+    std::string indent = "    ";
+
+    if ( term.operands.empty() ) {
+        return indent + accumulate(term, output, "1.0");
+    }
+
+    std::string product;
+    for (int i = 0; i < (int)term.operands.size(); i++) {
+        if ( i > 0 ) product += " * ";
+        product += operand_element(term.operands[i]);
+    }
+
+    std::vector<label> summed = summed_labels(term, output);
+
+    open_loops(code, output, indent);
+    if ( summed.empty() ) {
+        code += indent + accumulate(term, output, product);
+    }else {
+        // a scope for the sum, if there are no loops over output labels to provide one
+        if ( output.empty() ) {
+            code += indent + "{\n";
+            indent += "    ";
+        }
+        code += indent + "double sum = 0.0;\n";
+        open_loops(code, summed, indent);
+        code += indent + "sum += " + product + ";\n";
+        close_loops(code, (int)summed.size(), indent);
+        code += indent + accumulate(term, output, "sum");
+        if ( output.empty() ) {
+            close_loops(code, 1, indent);
+        }
+    }
+    close_loops(code, (int)output.size(), indent);
+
+    return code;
+}
+
+/// can every step of a contraction path be carried out as a matrix product? this rules 
+/// out delta functions, traces, and labels shared by two arrays that are also kept 
+/// (batched products)
+static bool gemm_compatible(const codegen_term & term, const contraction_path & path) {
+
+    if ( (int)term.operands.size() < 2 ) return false;
+
+    std::vector<std::vector<label> > nodes;
+    for (int i = 0; i < (int)term.operands.size(); i++) {
+        const std::vector<label> & labels = term.operands[i].labels;
+        if ( term.operands[i].argument == "kd" ) return false;
+        for (int j = 0; j < (int)labels.size(); j++) {
+            if ( std::count(labels.begin(), labels.end(), labels[j]) > 1 ) return false;
+        }
+        nodes.push_back(labels);
+    }
+
+    for (int k = 0; k < (int)path.steps.size(); k++) {
+
+        const std::vector<label> & left  = nodes[path.steps[k].left];
+        const std::vector<label> & right = nodes[path.steps[k].right];
+        const std::vector<label> & kept  = path.steps[k].labels;
+
+        for (int i = 0; i < (int)left.size(); i++) {
+            bool shared = std::find(right.begin(), right.end(), left[i]) != right.end();
+            bool needed = std::find(kept.begin(), kept.end(), left[i]) != kept.end();
+            if ( shared == needed ) return false;
+        }
+        for (int i = 0; i < (int)right.size(); i++) {
+            bool shared = std::find(left.begin(), left.end(), right[i]) != left.end();
+            bool needed = std::find(kept.begin(), kept.end(), right[i]) != kept.end();
+            if ( !shared && !needed ) return false;
+        }
+        nodes.push_back(kept);
+    }
+    return true;
+}
+
+/// copy (a slice of) an array into a blocked matrix whose rows and columns run over 
+/// the given labels. arrays already laid out that way are used in place
+static std::string pack(const std::string & name, const std::string & source, const std::vector<label> & source_labels, 
+                        bool sliced, const std::vector<label> & rows, const std::vector<label> & cols, std::string indent) {
+
+    std::vector<label> labels = rows;
+    labels.insert(labels.end(), cols.begin(), cols.end());
+
+    if ( !sliced && labels == source_labels ) {
+        return indent + "const double * " + name + " = " + source + ";\n";
+    }
+
+    std::string code;
+    code += indent + "std::vector<double> " + name + "_(" + array_size(labels) + ");\n";
+    code += indent + "const double * " + name + " = " + name + "_.data();\n";
+    std::string my_indent = indent;
+    open_loops(code, labels, my_indent);
+    code += my_indent + name + "_[" + array_offset(labels, false) + "] = " + source + "[" + array_offset(source_labels, sliced) + "];\n";
+    close_loops(code, (int)labels.size(), my_indent);
+    return code;
+}
+
+/// an array, or a product of arrays, in a generated c++ term
+struct gemm_node {
+
+    /// pointer to its elements
+    std::string source;
+
+    /// labels for each axis
+    std::vector<label> labels;
+
+    /// does it span all orbitals (integrals) or is it blocked?
+    bool sliced;
+
+};
+
+/// a term as a sequence of transposes and matrix products, one for each step of a contraction path
+static std::string gemm_term(const codegen_term & term, const std::vector<label> & output, const contraction_path & path) {
+
+    std::string indent = "        ";
+    std::string code = "    {\n";
+
+    std::vector<gemm_node> nodes;
+    for (int i = 0; i < (int)term.operands.size(); i++) {
+        nodes.push_back({term.operands[i].argument, term.operands[i].labels, term.operands[i].sliced});
+    }
+
+    for (int k = 0; k < (int)path.steps.size(); k++) {
+
+        const gemm_node left  = nodes[path.steps[k].left];
+        const gemm_node right = nodes[path.steps[k].right];
+        const std::vector<label> & kept = path.steps[k].labels;
+
+        // rows: labels kept from the left; inner: labels shared by both; columns: labels kept from the right
+        std::vector<label> rows, inner, cols;
+        for (int i = 0; i < (int)left.labels.size(); i++) {
+            if ( std::find(kept.begin(), kept.end(), left.labels[i]) != kept.end() ) {
+                rows.push_back(left.labels[i]);
+            }else {
+                inner.push_back(left.labels[i]);
+            }
+        }
+        for (int i = 0; i < (int)right.labels.size(); i++) {
+            if ( std::find(inner.begin(), inner.end(), right.labels[i]) == inner.end() ) {
+                cols.push_back(right.labels[i]);
+            }
+        }
+
+        std::string a = "a" + std::to_string(k + 1);
+        std::string b = "b" + std::to_string(k + 1);
+        std::string x = "x" + std::to_string(k + 1);
+
+        code += pack(a, left.source, left.labels, left.sliced, rows, inner, indent);
+        code += pack(b, right.source, right.labels, right.sliced, inner, cols, indent);
+
+        std::vector<label> product = rows;
+        product.insert(product.end(), cols.begin(), cols.end());
+        code += indent + "std::vector<double> " + x + "_(" + array_size(product) + ");\n";
+        code += indent + "double * " + x + " = " + x + "_.data();\n";
+        code += indent + "pq_gemm(" + array_size(rows) + ", " + array_size(cols) + ", " + array_size(inner) + ", "
+              + a + ", " + b + ", " + x + ");\n";
+
+        nodes.push_back({x, product, false});
+    }
+
+    std::string my_indent = indent;
+    open_loops(code, output, my_indent);
+    code += my_indent + accumulate(term, output, nodes.back().source + "[" + array_offset(nodes.back().labels, false) + "]");
+    close_loops(code, (int)output.size(), my_indent);
+
+    code += "    }\n";
+    return code;
+}
+
+std::string cpp_function(const std::vector<std::shared_ptr<pq> > & strings, std::string name, std::vector<std::string> output_labels, bool use_gemm, double n_occ, double n_vir) {
+
+    std::vector<codegen_term> terms = fully_contracted_terms(strings);
+
+    std::vector<label> output = residual_labels(terms, name, output_labels);
+
+    std::vector<std::string> arguments = term_arguments(terms);
+
+    std::string code;
+    code += "// " + name + ": " + std::to_string(terms.size()) + " fully-contracted terms\n";
+    code += "//\n";
+    code += "// o and v are the numbers of occupied and virtual orbitals. arrays are row major.\n";
+    code += "// integrals (f, h, g, ...) span all n = o + v orbitals, with the occupied ones first,\n";
+    code += "// and g holds antisymmetrized integrals <pq||rs>. amplitudes are blocked, e.g.,\n";
+    code += "// t2[((a*v + b)*o + i)*o + j]. the residual is blocked, too, and is overwritten\n";
+    code += "void " + name + "(long o, long v";
+    for (int i = 0; i < (int)arguments.size(); i++) {
+        if ( arguments[i].size() == 2 && arguments[i][1] == '0' ) {
+            code += ", double " + arguments[i];
+        }else {
+            code += ", const double * " + arguments[i];
+        }
+    }
+    code += ", double * residual) {\n";
+    code += "\n";
+
+    // n appears in offsets into integrals and in the dimensions of general labels
+    bool need_n = false;
+    for (int i = 0; i < (int)terms.size(); i++) {
+        for (int j = 0; j < (int)terms[i].operands.size(); j++) {
+            const term_operand & op = terms[i].operands[j];
+            if ( op.sliced && op.argument != "kd" ) need_n = true;
+            for (int k = 0; k < (int)op.labels.size(); k++) {
+                if ( !op.labels[k].is_occ() && !op.labels[k].is_vir() ) need_n = true;
+            }
+        }
+    }
+    if ( need_n ) {
+        code += "    const long n = o + v;\n";
+        code += "\n";
+    }
+    code += "    std::fill(residual, residual + " + array_size(output) + ", 0.0);\n";
+
+    for (int i = 0; i < (int)terms.size(); i++) {
+        code += "\n";
+        code += "    // " + terms[i].comment + "\n";
+        contraction_path path = term_path(terms[i], output, n_occ, n_vir);
+        if ( use_gemm && gemm_compatible(terms[i], path) ) {
+            code += gemm_term(terms[i], output, path);
+        }else {
+            code += loop_term(terms[i], output);
+        }
+    }
+
+    code += "}\n";
+
+    return code;
+}
+
+std::string cpp_module(const std::vector<std::string> & functions) {
+
+    std::string code;
+    code += "// residuals generated by pdaggerq\n";
+    code += "\n";
+    code += "#include<vector>\n";
+    code += "#include<algorithm>\n";
+    code += "\n";
+    code += "extern \"C\" void dgemm_(const char * transa, const char * transb, const int * m, const int * n, const int * k,\n";
+    code += "                       const double * alpha, const double * a, const int * lda, const double * b, const int * ldb,\n";
+    code += "                       const double * beta, double * c, const int * ldc);\n";
+    code += "\n";
+    code += "// c(m,n) = a(m,k) b(k,n), with all matrices row major\n";
+    code += "inline void pq_gemm(long m, long n, long k, const double * a, const double * b, double * c) {\n";
+    code += "    if ( m == 0 || n == 0 ) return;\n";
+    code += "    if ( k == 0 ) {\n";
+    code += "        std::fill(c, c + m*n, 0.0);\n";
+    code += "        return;\n";
+    code += "    }\n";
+    code += "    int im = (int)m, in = (int)n, ik = (int)k;\n";
+    code += "    double one = 1.0, zero = 0.0;\n";
+    code += "    dgemm_(\"N\", \"N\", &in, &im, &ik, &one, b, &in, a, &ik, &zero, c, &in);\n";
+    code += "}\n";
+    for (int i = 0; i < (int)functions.size(); i++) {
+        code += "\n";
+        code += functions[i];
+    }
+    return code;
+}
+
+std::vector<term_contraction> contraction_paths(const std::vector<std::shared_ptr<pq> > & strings, double n_occ, double n_vir) {
+
+    std::vector<codegen_term> terms = fully_contracted_terms(strings);
+
+    std::vector<term_contraction> paths;
+    for (int i = 0; i < (int)terms.size(); i++) {
+
+        term_contraction me;
+        me.string = terms[i].string;
+        for (int j = 0; j < (int)terms[i].operands.size(); j++) {
+            const term_operand & op = terms[i].operands[j];
+            std::string array = op.argument + "(";
+            for (int k = 0; k < (int)op.labels.size(); k++) {
+                if ( k > 0 ) array += ",";
+                array += op.labels[k].str();
+            }
+            me.arrays.push_back(array + ")");
+        }
+        me.path = term_path(terms[i], external_labels(terms[i]), n_occ, n_vir);
+
+        paths.push_back(me);
+    }
+    return paths;
+}
+
+}
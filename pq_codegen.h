@@ -0,0 +1,84 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: pq_codegen.h
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef PQ_CODEGEN_H
+#define PQ_CODEGEN_H
+
+#include<memory>
+#include<vector>
+#include<string>
+
+#include "pq.h"
+#include "contraction_path.h"
+
+namespace pdaggerq {
+
+/// python source for a function that evaluates a list of fully-contracted strings with 
+/// numpy.einsum. output_labels sets the order of the axes of the result (empty: virtual
+/// labels followed by occupied ones, each alphabetically). arguments are the integrals 
+/// and amplitudes that appear in the strings plus slices o and v for the occupied and 
+/// virtual orbitals. integrals are full arrays that get sliced; amplitudes are not.
+/// each term is contracted along its optimal_contraction_path for n_occ occupied and 
+/// n_vir virtual orbitals
+std::string einsum_function(const std::vector<std::shared_ptr<pq> > & strings, std::string name, std::vector<std::string> output_labels, double n_occ, double n_vir);
+
+/// python source for a module holding functions built by einsum_function
+std::string einsum_module(const std::vector<std::string> & functions);
+
+/// c++ source for a function that evaluates a list of fully-contracted strings and 
+/// overwrites a (blocked, row-major) residual. arguments are as for einsum_function, 
+/// except that o and v are the numbers of occupied and virtual orbitals. with use_gemm, 
+/// terms whose optimal_contraction_path (for n_occ and n_vir) is a sequence of matrix 
+/// products are lowered to transposes and calls to dgemm; other terms (and all terms 
+/// without use_gemm) become loop nests with the residual's labels outermost and the 
+/// summed labels innermost
+std::string cpp_function(const std::vector<std::shared_ptr<pq> > & strings, std::string name, std::vector<std::string> output_labels, bool use_gemm, double n_occ, double n_vir);
+
+/// c++ source for a file holding functions built by cpp_function, along with the
+/// matrix-product helper they call (which needs a blas library providing dgemm_)
+std::string cpp_module(const std::vector<std::string> & functions);
+
+/// a fully-contracted string, its arrays, and the cheapest order in which to contract them
+struct term_contraction {
+
+    /// the string, as from pq::get_string
+    std::vector<std::string> string;
+
+    /// arrays in the order that the path refers to them, e.g., g(i,j,a,b) or t2(a,b,i,j)
+    /// (kd is a delta function)
+    std::vector<std::string> arrays;
+
+    /// the optimal contraction path
+    contraction_path path;
+
+};
+
+/// optimal contraction paths for a list of fully-contracted strings, for n_occ occupied 
+/// and n_vir virtual orbitals
+std::vector<term_contraction> contraction_paths(const std::vector<std::shared_ptr<pq> > & strings, double n_occ, double n_vir);
+
+}
+
+#endif
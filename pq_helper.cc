@@ -32,58 +32,19 @@
 #include<string>
 #include <cctype>
 #include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<fstream>
+#include<sys/stat.h>
 
 #include "data.h"
 #include "pq.h"
 #include "pq_helper.h"
-
-#include <pybind11/pybind11.h>
-#include <pybind11/numpy.h>
-#include <pybind11/stl.h>
-
-namespace py = pybind11;
-using namespace pybind11::literals;
+#include "pq_io.h"
+#include "pq_codegen.h"
 
 namespace pdaggerq {
 
-void export_pq_helper(py::module& m) {
-    py::class_<pdaggerq::pq_helper, std::shared_ptr<pdaggerq::pq_helper> >(m, "pq_helper")
-        .def(py::init< std::string >())
-        .def("set_print_level", &pq_helper::set_print_level)
-        .def("set_bra", &pq_helper::set_bra)
-        .def("set_ket", &pq_helper::set_ket)
-        .def("set_string", &pq_helper::set_string)
-        .def("set_tensor", &pq_helper::set_tensor)
-        .def("set_t_amplitudes", &pq_helper::set_t_amplitudes)
-        .def("set_u_amplitudes", &pq_helper::set_u_amplitudes)
-        .def("set_m_amplitudes", &pq_helper::set_m_amplitudes)
-        .def("set_s_amplitudes", &pq_helper::set_s_amplitudes)
-        .def("set_left_amplitudes", &pq_helper::set_left_amplitudes)
-        .def("set_right_amplitudes", &pq_helper::set_right_amplitudes)
-        .def("set_left_operators", &pq_helper::set_left_operators)
-        .def("set_right_operators", &pq_helper::set_right_operators)
-        .def("set_factor", &pq_helper::set_factor)
-        .def("add_new_string", &pq_helper::add_new_string)
-        .def("add_operator_product", &pq_helper::add_operator_product)
-        .def("add_st_operator", &pq_helper::add_st_operator)
-        .def("add_commutator", &pq_helper::add_commutator)
-        .def("add_double_commutator", &pq_helper::add_double_commutator)
-        .def("add_triple_commutator", &pq_helper::add_triple_commutator)
-        .def("add_quadruple_commutator", &pq_helper::add_quadruple_commutator)
-        .def("simplify", &pq_helper::simplify)
-        .def("clear", &pq_helper::clear)
-        .def("print", &pq_helper::print)
-        .def("fully_contracted_strings", &pq_helper::fully_contracted_strings)
-        .def("print_fully_contracted", &pq_helper::print_fully_contracted)
-        .def("print_one_body", &pq_helper::print_one_body)
-        .def("print_two_body", &pq_helper::print_two_body);
-}
-
-PYBIND11_MODULE(pdaggerq, m) {
-    m.doc() = "Python API of pdaggerq: A code for bringing strings of creation / annihilation operators to normal order.";
-    export_pq_helper(m);
-}
-
 void removeStar(std::string &x)
 { 
   auto it = std::remove_if(std::begin(x),std::end(x),[](char c){return (c == '*');});
@@ -119,21 +80,328 @@ pq_helper::pq_helper(std::string vacuum_type)
 
     data = (std::shared_ptr<StringData>)(new StringData());
 
+    pool = (std::shared_ptr<pq_pool>)(new pq_pool());
+
     bra = "VACUUM";
     ket = "VACUUM";
 
     print_level = 0;
 
+    use_wick_enumerator = false;
+
+    num_threads = 1;
+
+    use_connected_only = false;
+
+    use_canonical_labels = false;
+
+    real_orbitals = false;
+
+    incremental_simplify = false;
+
+    collect_stats = false;
+
+    occupied_dimension = 10.0;
+    virtual_dimension  = 100.0;
+
+    cacheable = true;
+    replaying = false;
+
 }
 
 pq_helper::~pq_helper()
 {
+    // background tasks refer to this object
+    wait();
 }
 
 void pq_helper::set_print_level(int level) {
     print_level = level;
 }
 
+void pq_helper::set_use_wick_enumerator(bool do_use_wick_enumerator) {
+    use_wick_enumerator = do_use_wick_enumerator;
+}
+
+void pq_helper::set_connected_only(bool do_connected_only) {
+    use_connected_only = do_connected_only;
+}
+
+void pq_helper::set_use_canonical_labels(bool do_use_canonical_labels) {
+    use_canonical_labels = do_use_canonical_labels;
+}
+
+void pq_helper::set_real_orbitals(bool do_real_orbitals) {
+    real_orbitals = do_real_orbitals;
+}
+
+void pq_helper::set_incremental_simplify(bool do_incremental_simplify) {
+    incremental_simplify = do_incremental_simplify;
+}
+
+void pq_helper::set_collect_stats(bool do_collect_stats) {
+    collect_stats = do_collect_stats;
+}
+
+pq_stats pq_helper::get_stats() {
+
+    pq_stats me = stats;
+    me.strings_created = (long int)pool->created();
+    me.peak_strings    = (long int)pool->peak();
+    return me;
+
+}
+
+void pq_helper::reset_stats() {
+    stats.clear();
+    pool->reset_counters();
+}
+
+// bump this whenever a change to the code changes the strings it produces, so old cache files are not used
+static const int cache_version = 2;
+
+// 64-bit FNV-1a hash
+static unsigned long long fnv1a(const std::string & in) {
+    unsigned long long hash = 14695981039346656037ull;
+    for (int i = 0; i < (int)in.size(); i++) {
+        hash ^= (unsigned char)in[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static std::string describe_list(const std::vector<std::string> & list) {
+    std::string me = "[";
+    for (int i = 0; i < (int)list.size(); i++) {
+        if ( i > 0 ) me += ",";
+        me += list[i];
+    }
+    return me + "]";
+}
+
+void pq_helper::set_cache_dir(std::string dir) {
+
+    // anything recorded so far was recorded for the old directory
+    flush_pending_calls();
+
+    cache_dir = dir;
+    if ( cache_dir.empty() ) return;
+
+    mkdir(cache_dir.c_str(), 0755);
+
+    struct stat info;
+    if ( stat(cache_dir.c_str(), &info) != 0 || !S_ISDIR(info.st_mode) ) {
+        printf("\n");
+        printf("    error: invalid cache directory (%s)\n",cache_dir.c_str());
+        printf("\n");
+        exit(1);
+    }
+}
+
+bool pq_helper::defer_call(std::string name, double factor, std::vector<std::vector<std::string> > args, std::function<void()> call) {
+
+    if ( cache_dir.empty() || !cacheable || replaying ) return false;
+
+    // everything that determines the strings this call will produce
+    char factor_str[64];
+    snprintf(factor_str, sizeof(factor_str), "%.17g", factor);
+    std::string me = name + " " + factor_str;
+    for (int i = 0; i < (int)args.size(); i++) {
+        me += " " + describe_list(args[i]);
+    }
+    me += " bra=" + bra + " ket=" + ket;
+    me += " left=" + describe_list(left_operators) + " right=" + describe_list(right_operators);
+    me += " wick=" + std::to_string(use_wick_enumerator) + " connected=" + std::to_string(use_connected_only);
+    me += " canonical=" + std::to_string(use_canonical_labels) + " real=" + std::to_string(real_orbitals);
+    me += " incremental=" + std::to_string(incremental_simplify);
+    cache_log += me + "\n";
+
+    // when the call is carried out, the settings should be those in effect now
+    std::string my_bra = bra;
+    std::string my_ket = ket;
+    std::vector<std::string> my_left = left_operators;
+    std::vector<std::string> my_right = right_operators;
+    bool my_wick = use_wick_enumerator;
+    bool my_connected = use_connected_only;
+    bool my_canonical = use_canonical_labels;
+    bool my_real = real_orbitals;
+    bool my_incremental = incremental_simplify;
+    pending_calls.push_back([=]() {
+        bra = my_bra;
+        ket = my_ket;
+        left_operators = my_left;
+        right_operators = my_right;
+        use_wick_enumerator = my_wick;
+        use_connected_only = my_connected;
+        use_canonical_labels = my_canonical;
+        real_orbitals = my_real;
+        incremental_simplify = my_incremental;
+        call();
+    });
+
+    return true;
+}
+
+void pq_helper::flush_pending_calls() {
+
+    if ( pending_calls.empty() ) return;
+
+    std::string my_bra = bra;
+    std::string my_ket = ket;
+    std::vector<std::string> my_left = left_operators;
+    std::vector<std::string> my_right = right_operators;
+    bool my_wick = use_wick_enumerator;
+    bool my_connected = use_connected_only;
+    bool my_canonical = use_canonical_labels;
+    bool my_real = real_orbitals;
+    bool my_incremental = incremental_simplify;
+
+    replaying = true;
+    for (int i = 0; i < (int)pending_calls.size(); i++) {
+        pending_calls[i]();
+    }
+    pending_calls.clear();
+    replaying = false;
+
+    bra = my_bra;
+    ket = my_ket;
+    left_operators = my_left;
+    right_operators = my_right;
+    use_wick_enumerator = my_wick;
+    use_connected_only = my_connected;
+    use_canonical_labels = my_canonical;
+    real_orbitals = my_real;
+    incremental_simplify = my_incremental;
+}
+
+std::shared_future<void> pq_helper::run_async(std::function<void()> task) {
+
+    std::lock_guard<std::mutex> guard(task_lock);
+
+    // tasks on the same object run one after the other, in the order they were started
+    std::shared_future<void> previous = last_task;
+    last_task = std::async(std::launch::async, [previous, task]() {
+        if ( previous.valid() ) previous.wait();
+        task();
+    }).share();
+
+    return last_task;
+}
+
+void pq_helper::wait() {
+
+    std::shared_future<void> me;
+    {
+        std::lock_guard<std::mutex> guard(task_lock);
+        me = last_task;
+    }
+    if ( me.valid() ) me.wait();
+
+}
+
+void pq_helper::set_num_threads(int n) {
+
+    if ( n < 1 ) {
+        printf("\n");
+        printf("    error: invalid number of threads (%i)\n",n);
+        printf("\n");
+        exit(1);
+    }
+
+    num_threads = n;
+
+    // the calling thread also does work, so only n - 1 workers are needed
+    threads.reset();
+    if ( num_threads > 1 ) {
+        threads = (std::shared_ptr<thread_pool>)(new thread_pool(num_threads - 1));
+    }
+}
+
+// one round of rearrangements for each string in a list. returns true if
+// all strings were already in normal order. n_pruned counts the strings
+// dropped because they can't be fully contracted. the vacuum is chosen at
+// compile time, so there is no per-string dispatch
+template <bool fermi> 
+static bool rearrange_strings(std::vector<std::shared_ptr<pq> > &tmp, long int &n_pruned) {
+
+    std::vector< std::shared_ptr<pq> > list;
+    bool done_rearranging = true;
+    for (int i = 0; i < (int)tmp.size(); i++) {
+        // don't bother rearranging strings that can't be fully contracted
+        if ( fermi ) tmp[i]->check_contractible();
+        if ( tmp[i]->skip ) n_pruned++;
+        bool am_i_done = fermi ? tmp[i]->normal_order_fermi_vacuum(list) 
+                               : tmp[i]->normal_order_true_vacuum(list);
+        if ( !am_i_done ) done_rearranging = false;
+    }
+    tmp.swap(list);
+
+    return done_rearranging;
+}
+
+// the strings generated from each string in tmp end up next to one another
+// (and in the same order) no matter how many rounds it takes to get there.
+// so, tmp can be split into contiguous chunks, each chunk can be brought to
+// normal order independently, and the results can be stitched back together
+// in their original order.
+void pq_helper::normal_order_strings(std::vector<std::shared_ptr<pq> > &tmp) {
+
+    pq_timer timer(collect_stats ? &stats.normal_order_time : nullptr);
+
+    // pick the vacuum once, rather than for every string
+    bool (*rearrange)(std::vector<std::shared_ptr<pq> > &, long int &) 
+        = ( vacuum == "FERMI" ) ? rearrange_strings<true> : rearrange_strings<false>;
+
+    // chunks per thread, so threads that finish early can pick up more work
+    int chunks_per_thread = 8;
+
+    int n_chunks = chunks_per_thread * num_threads;
+
+    // serial rearrangement until there is enough work for the threads
+    bool done_rearranging = false;
+    int pass = 0;
+    do {
+        long int n_pruned = 0;
+        done_rearranging = rearrange(tmp, n_pruned);
+        if ( collect_stats ) stats.add_pass(pass, (long int)tmp.size(), n_pruned);
+        pass++;
+    }while( !done_rearranging && ( num_threads == 1 || (int)tmp.size() < n_chunks ) );
+
+    if ( done_rearranging ) return;
+
+    std::vector< std::vector< std::shared_ptr<pq> > > chunks(n_chunks);
+    int n = (int)tmp.size();
+    for (int c = 0; c < n_chunks; c++) {
+        int start = (int)( (long int)n * c / n_chunks );
+        int end   = (int)( (long int)n * (c + 1) / n_chunks );
+        chunks[c].assign(tmp.begin() + start, tmp.begin() + end);
+    }
+    tmp.clear();
+
+    // strings created / pruned by each pass over each chunk
+    std::vector< std::vector<long int> > chunk_created(n_chunks);
+    std::vector< std::vector<long int> > chunk_pruned(n_chunks);
+
+    threads->run(n_chunks, [&](int c) {
+        bool chunk_done = false;
+        while ( !chunk_done ) {
+            long int n_pruned = 0;
+            chunk_done = rearrange(chunks[c], n_pruned);
+            chunk_created[c].push_back((long int)chunks[c].size());
+            chunk_pruned[c].push_back(n_pruned);
+        }
+    });
+
+    for (int c = 0; c < n_chunks; c++) {
+        tmp.insert(tmp.end(), chunks[c].begin(), chunks[c].end());
+        chunks[c].clear();
+        if ( !collect_stats ) continue;
+        for (int k = 0; k < (int)chunk_created[c].size(); k++) {
+            stats.add_pass(pass + k, chunk_created[c][k], chunk_pruned[c][k]);
+        }
+    }
+}
+
 void pq_helper::set_left_operators(std::vector<std::string> in) {
 
     left_operators.clear();
@@ -202,9 +470,193 @@ void pq_helper::set_ket(std::string ket_type){
     }
 }
 
-void pq_helper::add_commutator(double factor,
-                                 std::vector<std::string> op0,
-                                 std::vector<std::string> op1) {
+bool pq_helper::add_connected_operator_product(double factor, std::vector<std::vector<std::string> > ops) {
+
+    if ( !use_connected_only ) return false;
+
+    // connected terms are only generated by the enumerator, which requires the fermi vacuum
+    if ( vacuum != "FERMI" ) return false;
+
+    // the commutator of op0 with a set of cluster operators (which commute 
+    // with each other and have only quasi-particle creators) is the part of
+    // op0 op1 op2 ... in which each cluster operator is contracted with op0
+    for (int k = 1; k < (int)ops.size(); k++) {
+        if ( ops[k].size() != 1 ) return false;
+        std::string op = ops[k][0];
+        std::transform(op.begin(), op.end(), op.begin(), [](unsigned char c){ return std::tolower(c); });
+        removeParentheses(op);
+        if ( op != "t1" && op != "t2" && op != "t3" ) return false;
+    }
+
+    std::vector<std::string> in;
+    for (int k = 0; k < (int)ops.size(); k++) {
+        for (int i = 0; i < (int)ops[k].size(); i++) {
+            in.push_back(ops[k][i]);
+            connected_vertex.push_back(k);
+        }
+    }
+
+    add_operator_product(factor, in);
+
+    connected_vertex.clear();
+
+    return true;
+}
+
+// range of values of (number of quasi-particle creators) - (number of 
+// quasi-particle annihilators) among the fermionic operators that make 
+// up an operator, where quasi-particles are defined relative to the fermi 
+// vacuum. general labels could be either occupied or virtual.
+static void quasiparticle_range(std::string op, int & min, int & max) {
+
+    min = 0;
+    max = 0;
+
+    std::transform(op.begin(), op.end(), op.begin(), [](unsigned char c){ return std::tolower(c); });
+    removeParentheses(op);
+
+    if ( op.size() == 0 ) return;
+
+    // amplitudes: t, u, r, s excite; l, m de-excite
+    std::string rank = op.substr(1,1);
+    int n = 0;
+    if ( rank == "1" ) n = 1;
+    else if ( rank == "2" ) n = 2;
+    else if ( rank == "3" ) n = 3;
+
+    if ( op.substr(0,1) == "h" || op.substr(0,1) == "f" ) {
+        min = -2;
+        max =  2;
+    }else if ( op.substr(0,2) == "d+" || op.substr(0,2) == "d-" ) {
+        min = -2;
+        max =  2;
+    }else if ( op.substr(0,1) == "g" || op == "v" ) {
+        min = -4;
+        max =  4;
+    }else if ( op.substr(0,1) == "j" ) {
+        min = -2 * n;
+        max =  2 * n;
+    }else if ( op.substr(0,1) == "t" || op.substr(0,1) == "u" || op.substr(0,1) == "r" || op.substr(0,1) == "s" ) {
+        min = 2 * n;
+        max = 2 * n;
+    }else if ( op.substr(0,1) == "l" || op.substr(0,1) == "m" ) {
+        min = -2 * n;
+        max = -2 * n;
+    }else if ( op.substr(0,1) == "w" || op.substr(0,1) == "b" || op.substr(0,1) == "1" ) {
+        // bosons only
+    }else if ( op.substr(0,1) == "e" && n > 0 ) {
+        // first n labels are creators, last n are annihilators
+        std::vector<std::string> labels;
+        size_t start = 2;
+        size_t pos = op.find(",", start);
+        while ( pos != std::string::npos ) {
+            labels.push_back(op.substr(start, pos - start));
+            start = pos + 1;
+            pos = op.find(",", start);
+        }
+        labels.push_back(op.substr(start));
+        for (int i = 0; i < (int)labels.size(); i++) {
+            label idx(labels[i]);
+            bool is_creator = ( i < (int)labels.size() / 2 );
+            if ( idx.is_vir() ) {
+                min += is_creator ? 1 : -1;
+                max += is_creator ? 1 : -1;
+            }else if ( idx.is_occ() ) {
+                min += is_creator ? -1 : 1;
+                max += is_creator ? -1 : 1;
+            }else {
+                min--;
+                max++;
+            }
+        }
+    }else {
+        // unknown operators are dealt with in add_operator_product
+        min = -1000;
+        max =  1000;
+    }
+}
+
+// range of quasi-particle counts for a set of alternative operators
+static void quasiparticle_range(std::vector<std::string> ops, int & min, int & max) {
+
+    if ( ops.size() == 0 ) {
+        min = 0;
+        max = 0;
+        return;
+    }
+
+    quasiparticle_range(ops[0], min, max);
+    for (int i = 1; i < (int)ops.size(); i++) {
+        int my_min, my_max;
+        quasiparticle_range(ops[i], my_min, my_max);
+        min = std::min(min, my_min);
+        max = std::max(max, my_max);
+    }
+}
+
+bool pq_helper::is_fully_contractible(std::vector<std::string> ops) {
+
+    // only fully-contracted strings are kept when normal order is defined 
+    // relative to the fermi vacuum
+    if ( vacuum != "FERMI" ) return true;
+
+    int min = 0;
+    int max = 0;
+
+    if ( bra == "SINGLES" || bra == "SINGLES_1" ) {
+        min -= 2;
+        max -= 2;
+    }else if ( bra == "DOUBLES" || bra == "DOUBLES_1" ) {
+        min -= 4;
+        max -= 4;
+    }else if ( bra == "TRIPLES" ) {
+        min -= 6;
+        max -= 6;
+    }
+
+    if ( ket == "SINGLES" || ket == "SINGLES_1" ) {
+        min += 2;
+        max += 2;
+    }else if ( ket == "DOUBLES" || ket == "DOUBLES_1" ) {
+        min += 4;
+        max += 4;
+    }
+
+    int my_min, my_max;
+
+    quasiparticle_range(left_operators, my_min, my_max);
+    min += my_min;
+    max += my_max;
+
+    quasiparticle_range(right_operators, my_min, my_max);
+    min += my_min;
+    max += my_max;
+
+    for (int i = 0; i < (int)ops.size(); i++) {
+        quasiparticle_range(ops[i], my_min, my_max);
+        min += my_min;
+        max += my_max;
+    }
+
+    // every quasi-particle creator must be paired with an annihilator
+    return ( min <= 0 && max >= 0 );
+}
+
+int pq_helper::add_commutator(double factor,
+                                std::vector<std::string> op0,
+                                std::vector<std::string> op1) {
+
+    // skip commutators that cannot contribute to fully-contracted strings
+    std::vector<std::string> all_ops;
+    for (int i = 0; i < (int)op0.size(); i++) all_ops.push_back(op0[i]);
+    for (int i = 0; i < (int)op1.size(); i++) all_ops.push_back(op1[i]);
+    if ( !is_fully_contractible(all_ops) ) return 1;
+
+    // carry this out later, if at all
+    if ( defer_call("add_commutator", factor, {op0, op1}, [=]() { add_commutator(factor, op0, op1); }) ) return 0;
+
+    // or just generate the connected terms
+    if ( add_connected_operator_product(factor, {op0, op1}) ) return 0;
 
     // op0 op1
     std::vector<std::string> tmp;
@@ -219,12 +671,26 @@ void pq_helper::add_commutator(double factor,
     add_operator_product(-factor, tmp );
     tmp.clear();
 
+    return 0;
 }
 
-void pq_helper::add_double_commutator(double factor,
-                                        std::vector<std::string> op0, 
-                                        std::vector<std::string> op1, 
-                                        std::vector<std::string> op2) {
+int pq_helper::add_double_commutator(double factor,
+                                       std::vector<std::string> op0, 
+                                       std::vector<std::string> op1, 
+                                       std::vector<std::string> op2) {
+
+    // skip commutators that cannot contribute to fully-contracted strings
+    std::vector<std::string> all_ops;
+    for (int i = 0; i < (int)op0.size(); i++) all_ops.push_back(op0[i]);
+    for (int i = 0; i < (int)op1.size(); i++) all_ops.push_back(op1[i]);
+    for (int i = 0; i < (int)op2.size(); i++) all_ops.push_back(op2[i]);
+    if ( !is_fully_contractible(all_ops) ) return 1;
+
+    // carry this out later, if at all
+    if ( defer_call("add_double_commutator", factor, {op0, op1, op2}, [=]() { add_double_commutator(factor, op0, op1, op2); }) ) return 0;
+
+    // or just generate the connected terms
+    if ( add_connected_operator_product(factor, {op0, op1, op2}) ) return 0;
 
     std::vector<std::string> tmp;
 
@@ -256,13 +722,28 @@ void pq_helper::add_double_commutator(double factor,
     add_operator_product( factor, tmp );
     tmp.clear();
 
+    return 0;
 }
 
-void pq_helper::add_triple_commutator(double factor,
-                                        std::vector<std::string> op0,
-                                        std::vector<std::string> op1,
-                                        std::vector<std::string> op2,
-                                        std::vector<std::string> op3) {
+int pq_helper::add_triple_commutator(double factor,
+                                       std::vector<std::string> op0,
+                                       std::vector<std::string> op1,
+                                       std::vector<std::string> op2,
+                                       std::vector<std::string> op3) {
+
+    // skip commutators that cannot contribute to fully-contracted strings
+    std::vector<std::string> all_ops;
+    for (int i = 0; i < (int)op0.size(); i++) all_ops.push_back(op0[i]);
+    for (int i = 0; i < (int)op1.size(); i++) all_ops.push_back(op1[i]);
+    for (int i = 0; i < (int)op2.size(); i++) all_ops.push_back(op2[i]);
+    for (int i = 0; i < (int)op3.size(); i++) all_ops.push_back(op3[i]);
+    if ( !is_fully_contractible(all_ops) ) return 1;
+
+    // carry this out later, if at all
+    if ( defer_call("add_triple_commutator", factor, {op0, op1, op2, op3}, [=]() { add_triple_commutator(factor, op0, op1, op2, op3); }) ) return 0;
+
+    // or just generate the connected terms
+    if ( add_connected_operator_product(factor, {op0, op1, op2, op3}) ) return 0;
 
     std::vector<std::string> tmp;
 
@@ -330,14 +811,30 @@ void pq_helper::add_triple_commutator(double factor,
     add_operator_product(-factor, tmp );
     tmp.clear();
 
+    return 0;
 }
 
-void pq_helper::add_quadruple_commutator(double factor,
-                                           std::vector<std::string> op0,
-                                           std::vector<std::string> op1,
-                                           std::vector<std::string> op2,
-                                           std::vector<std::string> op3,
-                                           std::vector<std::string> op4) {
+int pq_helper::add_quadruple_commutator(double factor,
+                                          std::vector<std::string> op0,
+                                          std::vector<std::string> op1,
+                                          std::vector<std::string> op2,
+                                          std::vector<std::string> op3,
+                                          std::vector<std::string> op4) {
+
+    // skip commutators that cannot contribute to fully-contracted strings
+    std::vector<std::string> all_ops;
+    for (int i = 0; i < (int)op0.size(); i++) all_ops.push_back(op0[i]);
+    for (int i = 0; i < (int)op1.size(); i++) all_ops.push_back(op1[i]);
+    for (int i = 0; i < (int)op2.size(); i++) all_ops.push_back(op2[i]);
+    for (int i = 0; i < (int)op3.size(); i++) all_ops.push_back(op3[i]);
+    for (int i = 0; i < (int)op4.size(); i++) all_ops.push_back(op4[i]);
+    if ( !is_fully_contractible(all_ops) ) return 1;
+
+    // carry this out later, if at all
+    if ( defer_call("add_quadruple_commutator", factor, {op0, op1, op2, op3, op4}, [=]() { add_quadruple_commutator(factor, op0, op1, op2, op3, op4); }) ) return 0;
+
+    // or just generate the connected terms
+    if ( add_connected_operator_product(factor, {op0, op1, op2, op3, op4}) ) return 0;
 
     std::vector<std::string> tmp;
 
@@ -485,12 +982,16 @@ void pq_helper::add_quadruple_commutator(double factor,
     add_operator_product( factor, tmp );
     tmp.clear();
 
+    return 0;
 }
 
 // add a string of operators
 
 void pq_helper::add_operator_product(double factor, std::vector<std::string>  in){
 
+    // carry this out later, if at all
+    if ( defer_call("add_operator_product", factor, {in}, [=]() { add_operator_product(factor, in); }) ) return;
+
     // first check if there is a fluctuation potential operator 
     // that needs to be split into multiple terms
 
@@ -567,6 +1068,11 @@ void pq_helper::add_operator_product(double factor, std::vector<std::string>  in
     }
 
 
+    // time spent here, less time spent bringing strings to normal order and cleaning up
+    std::chrono::steady_clock::time_point start;
+    double other_time = stats.normal_order_time + stats.cleanup_time;
+    if ( collect_stats ) start = std::chrono::steady_clock::now();
+
     // apply any extra operators on left or right:
     std::vector<std::string> save;
     for (int i = 0; i < (int)in.size(); i++) {
@@ -580,13 +1086,14 @@ void pq_helper::add_operator_product(double factor, std::vector<std::string>  in
         right_operators.push_back("1");
     }
 
-    double original_factor = factor;
+    // the working factor is exact: fractions like 1/36 are not rounded
+    rational original_factor = rational::from_double(factor);
 
     for (int left = 0; left < (int)left_operators.size(); left++) {
 
         for (int right = 0; right < (int)right_operators.size(); right++) {
 
-            factor = original_factor;
+            rational my_factor = original_factor;
 
             std::vector<std::string> tmp_string;
 
@@ -666,8 +1173,21 @@ void pq_helper::add_operator_product(double factor, std::vector<std::string>  in
             tmp.clear();
 
 
+            // vertex for each fermionic operator (see connected_vertex). the bra,
+            // ket, and left / right operators don't belong to any vertex
+            std::vector<int> tmp_vertex(tmp_string.size(), -1);
+
             for (int i = 0; i < (int)in.size(); i++) {
 
+                // vertex for any fermionic operators added in the previous pass
+                int my_vertex = -1;
+                if ( i > 1 && i - 2 < (int)connected_vertex.size() ) {
+                    my_vertex = connected_vertex[i - 2];
+                }
+                while ( tmp_vertex.size() < tmp_string.size() ) {
+                    tmp_vertex.push_back(my_vertex);
+                }
+
                 // blank string
                 if ( in[i].size() == 0 ) continue;
 
@@ -741,7 +1261,7 @@ void pq_helper::add_operator_product(double factor, std::vector<std::string>  in
 
                 }else if ( in[i].substr(0,1) == "g" ) { // general two-electron operator
 
-                    //factor *= 0.25;
+                    //my_factor *= rational(1, 4);
 
                     std::string idx1 = "p" + std::to_string(gen_label_count++);
                     std::string idx2 = "p" + std::to_string(gen_label_count++);
@@ -759,7 +1279,7 @@ void pq_helper::add_operator_product(double factor, std::vector<std::string>  in
 
                     if ( in[i].substr(1,1) == "1" ){
 
-                        factor *= -1.0;
+                        my_factor *= -1;
 
                         std::string idx1 = "p" + std::to_string(gen_label_count++);
                         std::string idx2 = "p" + std::to_string(gen_label_count++);
@@ -775,7 +1295,7 @@ void pq_helper::add_operator_product(double factor, std::vector<std::string>  in
 
                     }else if ( in[i].substr(1,1) == "2" ){
 
-                        factor *= 0.25;
+                        my_factor *= rational(1, 4);
 
                         std::string idx1 = "p" + std::to_string(gen_label_count++);
                         std::string idx2 = "p" + std::to_string(gen_label_count++);
@@ -806,7 +1326,7 @@ void pq_helper::add_operator_product(double factor, std::vector<std::string>  in
 
                     }else if ( in[i].substr(1,1) == "2" ){
 
-                        factor *= 0.25;
+                        my_factor *= rational(1, 4);
 
                         std::string idx1 = "v" + std::to_string(vir_label_count++);
                         std::string idx2 = "v" + std::to_string(vir_label_count++);
@@ -822,7 +1342,7 @@ void pq_helper::add_operator_product(double factor, std::vector<std::string>  in
 
                     }else if ( in[i].substr(1,1) == "3" ){
 
-                        factor *= 1.0 / 36.0;
+                        my_factor *= rational(1, 36);
 
                         std::string idx1 = "v" + std::to_string(vir_label_count++);
                         std::string idx2 = "v" + std::to_string(vir_label_count++);
@@ -897,7 +1417,7 @@ void pq_helper::add_operator_product(double factor, std::vector<std::string>  in
 
                     }else if ( in[i].substr(1,1) == "2" ){
 
-                        factor *= 0.25;
+                        my_factor *= rational(1, 4);
 
                         std::string idx1 = "v" + std::to_string(vir_label_count++);
                         std::string idx2 = "v" + std::to_string(vir_label_count++);
@@ -938,7 +1458,7 @@ void pq_helper::add_operator_product(double factor, std::vector<std::string>  in
 
                     }else if ( in[i].substr(1,1) == "2" ){
 
-                        factor *= 0.25;
+                        my_factor *= rational(1, 4);
 
                         std::string idx1 = "v" + std::to_string(vir_label_count++);
                         std::string idx2 = "v" + std::to_string(vir_label_count++);
@@ -981,7 +1501,7 @@ void pq_helper::add_operator_product(double factor, std::vector<std::string>  in
 
                     }else if ( in[i].substr(1,1) == "2" ){
 
-                        factor *= 0.25;
+                        my_factor *= rational(1, 4);
 
                         std::string idx1 = "v" + std::to_string(vir_label_count++);
                         std::string idx2 = "v" + std::to_string(vir_label_count++);
@@ -1022,7 +1542,7 @@ void pq_helper::add_operator_product(double factor, std::vector<std::string>  in
 
                     }else if ( in[i].substr(1,1) == "2" ){
 
-                        factor *= 0.25;
+                        my_factor *= rational(1, 4);
 
                         std::string idx1 = "o" + std::to_string(occ_label_count++);
                         std::string idx2 = "o" + std::to_string(occ_label_count++);
@@ -1065,7 +1585,7 @@ void pq_helper::add_operator_product(double factor, std::vector<std::string>  in
 
                     }else if ( in[i].substr(1,1) == "2" ){
 
-                        factor *= 0.25;
+                        my_factor *= rational(1, 4);
 
                         std::string idx1 = "o" + std::to_string(occ_label_count++);
                         std::string idx2 = "o" + std::to_string(occ_label_count++);
@@ -1191,7 +1711,7 @@ void pq_helper::add_operator_product(double factor, std::vector<std::string>  in
                 
             }
 
-            set_factor(factor);
+            data->factor = my_factor;
 
             if ( ket == "SINGLES" ) {
 
@@ -1233,6 +1753,13 @@ void pq_helper::add_operator_product(double factor, std::vector<std::string>  in
 
             set_string(tmp_string);
 
+            if ( connected_vertex.size() > 0 ) {
+                while ( tmp_vertex.size() < tmp_string.size() ) {
+                    tmp_vertex.push_back(-1);
+                }
+                data->vertex = tmp_vertex;
+            }
+
             data->has_r0       = has_r0;
             data->has_l0       = has_l0;
             data->has_u0       = has_u0;
@@ -1247,6 +1774,10 @@ void pq_helper::add_operator_product(double factor, std::vector<std::string>  in
         }
     }
 
+    if ( collect_stats ) {
+        other_time = stats.normal_order_time + stats.cleanup_time - other_time;
+        stats.expand_time += seconds_since(start) - other_time;
+    }
 
 }
 
@@ -1264,7 +1795,7 @@ void pq_helper::set_tensor(std::vector<std::string> in, std::string tensor_type)
 }
 
 void pq_helper::set_t_amplitudes(std::vector<std::string> in) {
-    std::vector<std::string> tmp;
+    std::vector<label> tmp;
     for (int i = 0; i < (int)in.size(); i++) {
         tmp.push_back(in[i]);
     }
@@ -1272,7 +1803,7 @@ void pq_helper::set_t_amplitudes(std::vector<std::string> in) {
 }
 
 void pq_helper::set_u_amplitudes(std::vector<std::string> in) {
-    std::vector<std::string> tmp;
+    std::vector<label> tmp;
     for (int i = 0; i < (int)in.size(); i++) {
         tmp.push_back(in[i]);
     }
@@ -1280,7 +1811,7 @@ void pq_helper::set_u_amplitudes(std::vector<std::string> in) {
 }
 
 void pq_helper::set_m_amplitudes(std::vector<std::string> in) {
-    std::vector<std::string> tmp;
+    std::vector<label> tmp;
     for (int i = 0; i < (int)in.size(); i++) {
         tmp.push_back(in[i]);
     }
@@ -1288,7 +1819,7 @@ void pq_helper::set_m_amplitudes(std::vector<std::string> in) {
 }
 
 void pq_helper::set_s_amplitudes(std::vector<std::string> in) {
-    std::vector<std::string> tmp;
+    std::vector<label> tmp;
     for (int i = 0; i < (int)in.size(); i++) {
         tmp.push_back(in[i]);
     }
@@ -1296,7 +1827,7 @@ void pq_helper::set_s_amplitudes(std::vector<std::string> in) {
 }
 
 void pq_helper::set_left_amplitudes(std::vector<std::string> in) {
-    std::vector<std::string> tmp;
+    std::vector<label> tmp;
     for (int i = 0; i < (int)in.size(); i++) {
         tmp.push_back(in[i]);
     }
@@ -1304,7 +1835,7 @@ void pq_helper::set_left_amplitudes(std::vector<std::string> in) {
 }
 
 void pq_helper::set_right_amplitudes(std::vector<std::string> in) {
-    std::vector<std::string> tmp;
+    std::vector<label> tmp;
     for (int i = 0; i < (int)in.size(); i++) {
         tmp.push_back(in[i]);
     }
@@ -1312,19 +1843,19 @@ void pq_helper::set_right_amplitudes(std::vector<std::string> in) {
 }
 
 void pq_helper::set_factor(double in) {
-    data->factor = in;
+    data->factor = rational::from_double(in);
 }
 
 void pq_helper::add_new_string_true_vacuum(){
 
-    std::shared_ptr<pq> mystring (new pq(vacuum));
+    std::shared_ptr<pq> mystring = pool->get(vacuum);
 
-    if ( data->factor > 0.0 ) {
+    if ( data->factor.sign() > 0 ) {
         mystring->sign = 1;
-        mystring->data->factor = fabs(data->factor);
+        mystring->data->factor = data->factor.abs();
     }else {
         mystring->sign = -1;
-        mystring->data->factor = fabs(data->factor);
+        mystring->data->factor = data->factor.abs();
     }
 
     mystring->data->has_r0       = data->has_r0;
@@ -1353,14 +1884,14 @@ void pq_helper::add_new_string_true_vacuum(){
     mystring->data->tensor_type = data->tensor_type;
 
     for (int i = 0; i < (int)data->t_amplitudes.size(); i++) {
-        std::vector<std::string> tmp;
+        std::vector<label> tmp;
         for (int j = 0; j < (int)data->t_amplitudes[i].size(); j++) {
             tmp.push_back(data->t_amplitudes[i][j]);
         }
         mystring->data->t_amplitudes.push_back(tmp);
     }
     for (int i = 0; i < (int)data->u_amplitudes.size(); i++) {
-        std::vector<std::string> tmp;
+        std::vector<label> tmp;
         for (int j = 0; j < (int)data->u_amplitudes[i].size(); j++) {
             tmp.push_back(data->u_amplitudes[i][j]);
         }
@@ -1368,7 +1899,7 @@ void pq_helper::add_new_string_true_vacuum(){
     }
 
     for (int i = 0; i < (int)data->m_amplitudes.size(); i++) {
-        std::vector<std::string> tmp;
+        std::vector<label> tmp;
         for (int j = 0; j < (int)data->m_amplitudes[i].size(); j++) {
             tmp.push_back(data->m_amplitudes[i][j]);
         }
@@ -1376,7 +1907,7 @@ void pq_helper::add_new_string_true_vacuum(){
     }
 
     for (int i = 0; i < (int)data->s_amplitudes.size(); i++) {
-        std::vector<std::string> tmp;
+        std::vector<label> tmp;
         for (int j = 0; j < (int)data->s_amplitudes[i].size(); j++) {
             tmp.push_back(data->s_amplitudes[i][j]);
         }
@@ -1384,14 +1915,14 @@ void pq_helper::add_new_string_true_vacuum(){
     }
 
     for (int i = 0; i < (int)data->left_amplitudes.size(); i++) {
-        std::vector<std::string> tmp;
+        std::vector<label> tmp;
         for (int j = 0; j < (int)data->left_amplitudes[i].size(); j++) {
             tmp.push_back(data->left_amplitudes[i][j]);
         }
         mystring->data->left_amplitudes.push_back(tmp);
     }
     for (int i = 0; i < (int)data->right_amplitudes.size(); i++) {
-        std::vector<std::string> tmp;
+        std::vector<label> tmp;
         for (int j = 0; j < (int)data->right_amplitudes[i].size(); j++) {
             tmp.push_back(data->right_amplitudes[i][j]);
         }
@@ -1414,19 +1945,7 @@ void pq_helper::add_new_string_true_vacuum(){
     std::vector< std::shared_ptr<pq> > tmp;
     tmp.push_back(mystring);
 
-    bool done_rearranging = false;
-    do {  
-        std::vector< std::shared_ptr<pq> > list;
-        done_rearranging = true;
-        for (int i = 0; i < (int)tmp.size(); i++) {
-            bool am_i_done = tmp[i]->normal_order(list);
-            if ( !am_i_done ) done_rearranging = false;
-        }
-        tmp.clear();
-        for (int i = 0; i < (int)list.size(); i++) {
-            tmp.push_back(list[i]);
-        }
-    }while(!done_rearranging);
+    normal_order_strings(tmp);
 
     //ordered.clear();
     for (int i = 0; i < (int)tmp.size(); i++) {
@@ -1435,11 +1954,13 @@ void pq_helper::add_new_string_true_vacuum(){
     tmp.clear();
 
 
+    pq_timer timer(collect_stats ? &stats.cleanup_time : nullptr);
+
     // alphabetize
     mystring->alphabetize(ordered);
 
     // cancel terms
-    mystring->cleanup(ordered);
+    stats.compare_calls += mystring->cleanup(ordered, use_canonical_labels, real_orbitals, threads.get());
 
     // reset data object
     data.reset();
@@ -1449,6 +1970,12 @@ void pq_helper::add_new_string_true_vacuum(){
 
 void pq_helper::add_new_string() {
 
+    // strings added by hand can't be reproduced from the cache log
+    if ( !replaying ) {
+        flush_pending_calls();
+        cacheable = false;
+    }
+
     if ( vacuum == "TRUE" ) {
         add_new_string_true_vacuum();
     }else {
@@ -1460,7 +1987,7 @@ void pq_helper::add_new_string() {
 void pq_helper::add_new_string_fermi_vacuum(){
 
     std::vector<std::shared_ptr<pq> > mystrings;
-    mystrings.push_back( (std::shared_ptr<pq>)(new pq(vacuum)) );
+    mystrings.push_back( pool->get(vacuum) );
 
     // if normal order is defined with respect to the fermi vacuum, we must
     // check here if the input string contains any general-index operators
@@ -1484,7 +2011,7 @@ void pq_helper::add_new_string_fermi_vacuum(){
     if ( n_gen_idx > 0 ) {
         mystrings.clear();
         for (int i = 0; i < n_gen_idx * n_gen_idx; i++) {
-            mystrings.push_back( (std::shared_ptr<pq>)(new pq(vacuum)) );
+            mystrings.push_back( pool->get(vacuum) );
         }
     }
 
@@ -1499,12 +2026,12 @@ void pq_helper::add_new_string_fermi_vacuum(){
     for (int string_num = 0; string_num < n_gen_idx * n_gen_idx; string_num++) {
 
         // factors:
-        if ( data->factor > 0.0 ) {
+        if ( data->factor.sign() > 0 ) {
             mystrings[string_num]->sign = 1;
-            mystrings[string_num]->data->factor = fabs(data->factor);
+            mystrings[string_num]->data->factor = data->factor.abs();
         }else {
             mystrings[string_num]->sign = -1;
-            mystrings[string_num]->data->factor = fabs(data->factor);
+            mystrings[string_num]->data->factor = data->factor.abs();
         }
 
         mystrings[string_num]->data->has_r0       = data->has_r0;
@@ -1751,7 +2278,7 @@ void pq_helper::add_new_string_fermi_vacuum(){
         }
 
         for (int i = 0; i < (int)data->t_amplitudes.size(); i++) {
-            std::vector<std::string> tmp;
+            std::vector<label> tmp;
             for (int j = 0; j < (int)data->t_amplitudes[i].size(); j++) {
                 tmp.push_back(data->t_amplitudes[i][j]);
             }
@@ -1759,7 +2286,7 @@ void pq_helper::add_new_string_fermi_vacuum(){
         }
 
         for (int i = 0; i < (int)data->u_amplitudes.size(); i++) {
-            std::vector<std::string> tmp;
+            std::vector<label> tmp;
             for (int j = 0; j < (int)data->u_amplitudes[i].size(); j++) {
                 tmp.push_back(data->u_amplitudes[i][j]);
             }
@@ -1767,7 +2294,7 @@ void pq_helper::add_new_string_fermi_vacuum(){
         }
 
         for (int i = 0; i < (int)data->m_amplitudes.size(); i++) {
-            std::vector<std::string> tmp;
+            std::vector<label> tmp;
             for (int j = 0; j < (int)data->m_amplitudes[i].size(); j++) {
                 tmp.push_back(data->m_amplitudes[i][j]);
             }
@@ -1775,7 +2302,7 @@ void pq_helper::add_new_string_fermi_vacuum(){
         }
 
         for (int i = 0; i < (int)data->s_amplitudes.size(); i++) {
-            std::vector<std::string> tmp;
+            std::vector<label> tmp;
             for (int j = 0; j < (int)data->s_amplitudes[i].size(); j++) {
                 tmp.push_back(data->s_amplitudes[i][j]);
             }
@@ -1783,7 +2310,7 @@ void pq_helper::add_new_string_fermi_vacuum(){
         }
 
         for (int i = 0; i < (int)data->left_amplitudes.size(); i++) {
-            std::vector<std::string> tmp;
+            std::vector<label> tmp;
             for (int j = 0; j < (int)data->left_amplitudes[i].size(); j++) {
                 tmp.push_back(data->left_amplitudes[i][j]);
             }
@@ -1791,7 +2318,7 @@ void pq_helper::add_new_string_fermi_vacuum(){
         }
 
         for (int i = 0; i < (int)data->right_amplitudes.size(); i++) {
-            std::vector<std::string> tmp;
+            std::vector<label> tmp;
             for (int j = 0; j < (int)data->right_amplitudes[i].size(); j++) {
                 tmp.push_back(data->right_amplitudes[i][j]);
             }
@@ -1826,6 +2353,9 @@ void pq_helper::add_new_string_fermi_vacuum(){
         for (int i = 0; i < (int)data->is_boson_dagger.size(); i++) {
             mystrings[string_num]->data->is_boson_dagger.push_back(data->is_boson_dagger[i]);
         }
+        for (int i = 0; i < (int)data->vertex.size(); i++) {
+            mystrings[string_num]->data->vertex.push_back(data->vertex[i]);
+        }
 
         if ( print_level > 0 ) {
             printf("\n");
@@ -1834,30 +2364,23 @@ void pq_helper::add_new_string_fermi_vacuum(){
             mystrings[string_num]->print();
         }
 
-        // rearrange strings
-        //mystrings[string_num]->normal_order(ordered);
         std::vector< std::shared_ptr<pq> > tmp;
-        tmp.push_back(mystrings[string_num]);
 
-        bool done_rearranging = false;
-        do { 
-            std::vector< std::shared_ptr<pq> > list;
-            done_rearranging = true;
-            for (int i = 0; i < (int)tmp.size(); i++) {
-                bool am_i_done = tmp[i]->normal_order(list);
-                if ( !am_i_done ) done_rearranging = false;
-            }
-            tmp.clear();
-            for (int i = 0; i < (int)list.size(); i++) {
-                tmp.push_back(list[i]);
-            }
-        }while(!done_rearranging);
+        // only the fully-contracted terms survive cleanup, so those can be generated directly.
+        // connected terms can only be generated this way
+        if ( use_wick_enumerator || data->vertex.size() > 0 ) {
+            pq_timer timer(collect_stats ? &stats.normal_order_time : nullptr);
+            mystrings[string_num]->fully_contract(tmp);
+        }else {
 
-        //ordered.clear();
-        for (int i = 0; i < (int)tmp.size(); i++) {
-            ordered.push_back(tmp[i]);
+            // rearrange strings
+            //mystrings[string_num]->normal_order(ordered);
+            tmp.push_back(mystrings[string_num]);
+
+            normal_order_strings(tmp);
         }
-        tmp.clear();
+
+        keep_strings(tmp);
 
     }
 
@@ -1881,38 +2404,218 @@ void pq_helper::add_new_string_fermi_vacuum(){
 
 void pq_helper::simplify() {
 
+    // the simplified strings may already be cached
+    std::string cache_file;
+    std::string cache_key;
+    if ( !cache_dir.empty() && cacheable && !replaying ) {
+
+        cache_log += "simplify canonical=" + std::to_string(use_canonical_labels) + " real=" + std::to_string(real_orbitals) 
+                   + " incremental=" + std::to_string(incremental_simplify) + "\n";
+
+        cache_key = "pdaggerq cache version " + std::to_string(cache_version) 
+                        + " file version " + std::to_string(pq_file_version) 
+                        + " vacuum " + vacuum + "\n" + cache_log;
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", fnv1a(cache_key));
+        cache_file = cache_dir + "/" + name;
+
+        // the full key is stored in the file, so a hash collision is just a cache miss. 
+        // so is a file that can't be read (e.g., one that is truncated or corrupt)
+        std::vector<std::shared_ptr<pq> > cached;
+        std::string error;
+        if ( std::ifstream(cache_file).good() && load_strings(cache_file, vacuum, pool.get(), cached, cache_key, error) ) {
+            pending_calls.clear();
+            ordered.swap(cached);
+            merged_index.clear();
+            return;
+        }
+
+        flush_pending_calls();
+    }
+
+    simplify_strings(ordered);
+
     std::shared_ptr<pq> mystring (new pq(vacuum));
 
-    // eliminate strings based on delta functions and use delta functions to alter tensor / amplitude labels
-    for (int i = 0; i < (int)ordered.size(); i++) {
+    // try to cancel similar terms
+    pq_timer timer(collect_stats ? &stats.cleanup_time : nullptr);
+    if ( incremental_simplify && vacuum == "FERMI" ) {
+
+        // merge everything again (some strings may not have been merged as they were added, 
+        // e.g., if they were loaded from a file), so later strings can be merged with these
+        std::vector< std::shared_ptr<pq> > tmp;
+        tmp.swap(ordered);
+        merged_index.clear();
+        mystring->merge_canonical(tmp, ordered, merged_index, real_orbitals, threads.get());
+
+    }else {
+        stats.compare_calls += mystring->cleanup(ordered, use_canonical_labels, real_orbitals, threads.get());
+    }
+
+    if ( !cache_file.empty() ) {
+        // the cache is only an optimization, so failing to write to it is not an error
+        std::string error;
+        save_strings(cache_file, vacuum, ordered, cache_key, error);
+    }
+    
+}
 
-        if ( ordered[i]->skip ) continue;
+void pq_helper::keep_strings(std::vector<std::shared_ptr<pq> > &batch) {
 
-        // check spin
-        //ordered[i]->check_spin();
+    if ( !incremental_simplify ) {
+        ordered.insert(ordered.end(), batch.begin(), batch.end());
+        batch.clear();
+        return;
+    }
 
-        // check for occ/vir pairs in delta functions
-        ordered[i]->check_occ_vir();
+    // strings that are not in merged_index (e.g., those added before incremental_simplify 
+    // was set) are merged along with the new ones
+    if ( merged_index.empty() && !ordered.empty() ) {
+        batch.insert(batch.begin(), ordered.begin(), ordered.end());
+        ordered.clear();
+    }
+
+    simplify_strings(batch);
 
-        // apply delta functions
-        ordered[i]->gobble_deltas();
+    pq_timer timer(collect_stats ? &stats.cleanup_time : nullptr);
+    std::shared_ptr<pq> mystring (new pq(vacuum));
+    mystring->merge_canonical(batch, ordered, merged_index, real_orbitals, threads.get());
+}
 
-        // re-classify fluctuation potential terms
-        ordered[i]->reclassify_tensors();
+void pq_helper::simplify_strings(std::vector<std::shared_ptr<pq> > &list) {
 
-        // replace any funny labels that were added with conventional ones (fermi vacumm only)
-        if ( vacuum == "FERMI" ) {
-            ordered[i]->use_conventional_labels();
+    // eliminate strings based on delta functions and use delta functions to alter tensor / amplitude labels.
+    // each string is handled independently, so the work is spread over the thread pool
+    {
+        pq_timer timer(collect_stats ? &stats.gobble_deltas_time : nullptr);
+        parallel_for(threads.get(), (int)list.size(), [&](int i) {
+
+            // strings that have been simplified already (e.g., as they were added, with
+            // incremental_simplify) must not be simplified again
+            if ( list[i]->skip || list[i]->simplified ) return;
+
+            // check spin
+            //list[i]->check_spin();
+
+            // check for occ/vir pairs in delta functions
+            list[i]->check_occ_vir();
+
+            // apply delta functions
+            list[i]->gobble_deltas();
+
+            // re-classify fluctuation potential terms
+            list[i]->reclassify_tensors();
+        });
+    }
+
+    // replace any funny labels that were added with conventional ones (fermi vacumm only)
+    if ( vacuum == "FERMI" ) {
+        pq_timer timer(collect_stats ? &stats.relabel_time : nullptr);
+        parallel_for(threads.get(), (int)list.size(), [&](int i) {
+            if ( list[i]->skip || list[i]->simplified ) return;
+            list[i]->use_conventional_labels();
+        });
+    }
+
+    for (int i = 0; i < (int)list.size(); i++) {
+        list[i]->simplified = true;
+    }
+}
+
+void pq_helper::save(std::string filename) {
+    flush_pending_calls();
+    std::string error;
+    if ( !save_strings(filename, vacuum, ordered, "", error) ) {
+        printf("\n");
+        printf("    error: %s\n",error.c_str());
+        printf("\n");
+        exit(1);
+    }
+}
+
+void pq_helper::load(std::string filename) {
+    flush_pending_calls();
+    cacheable = false;
+    merged_index.clear();
+    std::string error;
+    if ( !load_strings(filename, vacuum, pool.get(), ordered, "", error) ) {
+        printf("\n");
+        printf("    error: %s\n",error.c_str());
+        printf("\n");
+        exit(1);
+    }
+}
+
+void pq_helper::set_dimension_estimates(double n_occ, double n_vir) {
+    occupied_dimension = n_occ;
+    virtual_dimension  = n_vir;
+}
+
+std::vector<term_contraction> pq_helper::contraction_paths() {
+    flush_pending_calls();
+    return pdaggerq::contraction_paths(ordered, occupied_dimension, virtual_dimension);
+}
+
+void pq_helper::print_contraction_paths() {
+
+    std::vector<term_contraction> paths = contraction_paths();
+
+    printf("\n");
+    printf("    ");
+    printf("// contraction paths (o = %g, v = %g):\n", occupied_dimension, virtual_dimension);
+    for (int i = 0; i < (int)paths.size(); i++) {
+        printf("    //");
+        for (int j = 0; j < (int)paths[i].string.size(); j++) {
+            printf(" %s", paths[i].string[j].c_str());
         }
+        printf("\n");
+        printf("    //     arrays:");
+        for (int j = 0; j < (int)paths[i].arrays.size(); j++) {
+            printf(" %s", paths[i].arrays[j].c_str());
+        }
+        printf("\n");
+        printf("    //     tree: %s, flops: %.3e, memory: %.3e\n", paths[i].path.tree.c_str(), paths[i].path.flops, paths[i].path.memory);
     }
+    printf("\n");
 
-    // try to cancel similar terms
-    mystring->cleanup(ordered);
-    
+}
+
+std::string pq_helper::einsum_function(std::string name, std::vector<std::string> output_labels) {
+    flush_pending_calls();
+    return pdaggerq::einsum_function(ordered, name, output_labels, occupied_dimension, virtual_dimension);
+}
+
+void pq_helper::write_einsum_module(std::string filename, std::vector<std::string> functions) {
+    std::ofstream file(filename);
+    if ( !file ) {
+        printf("\n");
+        printf("    error: could not open %s\n", filename.c_str());
+        printf("\n");
+        exit(1);
+    }
+    file << einsum_module(functions);
+}
+
+std::string pq_helper::cpp_function(std::string name, std::vector<std::string> output_labels, bool use_gemm) {
+    flush_pending_calls();
+    return pdaggerq::cpp_function(ordered, name, output_labels, use_gemm, occupied_dimension, virtual_dimension);
+}
+
+void pq_helper::write_cpp_module(std::string filename, std::vector<std::string> functions) {
+    std::ofstream file(filename);
+    if ( !file ) {
+        printf("\n");
+        printf("    error: could not open %s\n", filename.c_str());
+        printf("\n");
+        exit(1);
+    }
+    file << cpp_module(functions);
 }
 
 void pq_helper::print_two_body() {
 
+    flush_pending_calls();
+
     printf("\n");
     printf("    ");
     printf("// two-body strings:\n");
@@ -1926,6 +2629,8 @@ void pq_helper::print_two_body() {
 
 void pq_helper::print_fully_contracted() {
 
+    flush_pending_calls();
+
     printf("\n");
     printf("    ");
     printf("// fully-contracted strings:\n");
@@ -1940,6 +2645,8 @@ void pq_helper::print_fully_contracted() {
 
 std::vector<std::vector<std::string> > pq_helper::fully_contracted_strings() {
 
+    flush_pending_calls();
+
     std::vector<std::vector<std::string> > list;
     for (int i = 0; i < (int)ordered.size(); i++) {
         if ( ordered[i]->symbol.size() != 0 ) continue;
@@ -1956,6 +2663,8 @@ std::vector<std::vector<std::string> > pq_helper::fully_contracted_strings() {
 
 void pq_helper::print_one_body() {
 
+    flush_pending_calls();
+
     printf("\n");
     printf("    ");
     printf("// one-body strings:\n");
@@ -1969,6 +2678,8 @@ void pq_helper::print_one_body() {
 
 void pq_helper::print() {
 
+    flush_pending_calls();
+
     printf("\n");
     printf("    ");
     printf("// normal-ordered strings:\n");
@@ -1982,41 +2693,83 @@ void pq_helper::print() {
 void pq_helper::clear() {
 
     ordered.clear();
+    merged_index.clear();
+
+    pending_calls.clear();
+    cache_log.clear();
+    cacheable = true;
+
+    // all strings have been returned to the pool, so release their memory
+    pool->clear();
 
 }
 
-void pq_helper::add_st_operator(double factor, std::vector<std::string> targets, std::vector<std::string> ops) {
+// number of distinct orderings of a list of (sorted) indices, n! / (n_1! n_2! ...)
+static int count_orderings(std::vector<int> idx) {
+
+    int count = 1;
+    int run   = 1;
+    for (int i = 1; i < (int)idx.size(); i++) {
+        count *= (i + 1);
+        if ( idx[i] == idx[i-1] ) {
+            run++;
+            count /= run;
+        }else {
+            run = 1;
+        }
+    }
+    return count;
+}
+
+int pq_helper::add_st_operator(double factor, std::vector<std::string> targets, std::vector<std::string> ops) {
+
+    // carry this out later, if at all (the number of skipped terms is not known until then)
+    if ( defer_call("add_st_operator", factor, {targets, ops}, [=]() { add_st_operator(factor, targets, ops); }) ) return 0;
 
     int dim = (int)ops.size();
 
-    add_operator_product( factor, targets);
+    // number of terms skipped because they cannot be fully contracted
+    int n_skipped = 0;
+
+    if ( is_fully_contractible(targets) ) {
+        add_operator_product( factor, targets);
+    }else {
+        n_skipped++;
+    }
 
     for (int i = 0; i < dim; i++) {
-        add_commutator( factor, targets, {ops[i]});
+        n_skipped += add_commutator( factor, targets, {ops[i]});
     }
 
+    // the cluster operators commute, so nested commutators are unchanged by 
+    // permutations of the cluster operators. only generate each combination 
+    // once, weighted by its number of distinct orderings
     for (int i = 0; i < dim; i++) {
-        for (int j = 0; j < dim; j++) {
-            add_double_commutator( 0.5 * factor, targets, {ops[i]}, {ops[j]});
+        for (int j = i; j < dim; j++) {
+            double weight = count_orderings({i, j});
+            n_skipped += add_double_commutator( weight * 0.5 * factor, targets, {ops[i]}, {ops[j]});
         }
     }
     for (int i = 0; i < dim; i++) {
-        for (int j = 0; j < dim; j++) {
-            for (int k = 0; k < dim; k++) {
-                add_triple_commutator( 1.0 / 6.0 * factor, targets, {ops[i]}, {ops[j]}, {ops[k]});
+        for (int j = i; j < dim; j++) {
+            for (int k = j; k < dim; k++) {
+                double weight = count_orderings({i, j, k});
+                n_skipped += add_triple_commutator( weight / 6.0 * factor, targets, {ops[i]}, {ops[j]}, {ops[k]});
             }
         }
     }
     for (int i = 0; i < dim; i++) {
-        for (int j = 0; j < dim; j++) {
-            for (int k = 0; k < dim; k++) {
-                for (int l = 0; l < dim; l++) {
-                    add_quadruple_commutator( 1.0 / 24.0 * factor, targets, {ops[i]}, {ops[j]}, {ops[k]}, {ops[l]});
+        for (int j = i; j < dim; j++) {
+            for (int k = j; k < dim; k++) {
+                for (int l = k; l < dim; l++) {
+                    double weight = count_orderings({i, j, k, l});
+                    n_skipped += add_quadruple_commutator( weight / 24.0 * factor, targets, {ops[i]}, {ops[j]}, {ops[k]}, {ops[l]});
                 }
             }
         }
     }
 
+    return n_skipped;
 }
 
 } // End namespaces
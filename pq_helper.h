@@ -27,6 +27,14 @@
 
 #include "pq.h"
 #include "data.h"
+#include "thread_pool.h"
+#include "pq_stats.h"
+#include "pq_codegen.h"
+
+#include<future>
+#include<functional>
+#include<mutex>
+#include<unordered_map>
 
 namespace pdaggerq {
 
@@ -34,6 +42,9 @@ class pq_helper {
 
   private:
 
+    /// pool for strings generated by normal ordering (must outlive ordered)
+    std::shared_ptr<pq_pool> pool;
+
     /// list of strings of operators
     std::vector< std::shared_ptr<pq> > ordered;
 
@@ -58,6 +69,88 @@ class pq_helper {
     /// operators to apply to the right of any operator products we add
     std::vector<std::string> right_operators;
 
+    /// enumerate fully-contracted terms directly (fermi vacuum only)?
+    bool use_wick_enumerator;
+
+    /// number of threads used when bringing strings to normal order
+    int num_threads;
+
+    /// worker threads (only if num_threads > 1)
+    std::shared_ptr<thread_pool> threads;
+
+    /// generate only connected terms in commutators with cluster operators?
+    bool use_connected_only;
+
+    /// put fully-contracted strings in canonical form before merging them?
+    bool use_canonical_labels;
+
+    /// with use_canonical_labels, also use symmetries of tensors that hold only for real orbitals?
+    bool real_orbitals;
+
+    /// simplify and merge strings as they are added, rather than all at once in simplify()?
+    bool incremental_simplify;
+
+    /// with incremental_simplify, the position in ordered of the string with each canonical form
+    std::unordered_map<std::string, int> merged_index;
+
+    /// apply delta functions and relabel each string in a list (the first stage of simplify)
+    void simplify_strings(std::vector<std::shared_ptr<pq> > &list);
+
+    /// move newly generated strings into ordered, merging them with those already there if incremental_simplify
+    void keep_strings(std::vector<std::shared_ptr<pq> > &batch);
+
+    /// when generating connected terms, the vertex of each operator in the product being added
+    /// (0 for the operators in the first argument of a commutator, 1, 2, ... for cluster operators)
+    std::vector<int> connected_vertex;
+
+    /// add the connected part of op0 op1 op2 ..., if possible. returns false if the commutator must be expanded instead
+    bool add_connected_operator_product(double factor, std::vector<std::vector<std::string> > ops);
+
+    /// collect timings and counters?
+    bool collect_stats;
+
+    /// timings and counters (if collect_stats)
+    pq_stats stats;
+
+    /// number of occupied orbitals assumed when choosing contraction paths
+    double occupied_dimension;
+
+    /// number of virtual orbitals assumed when choosing contraction paths
+    double virtual_dimension;
+
+    /// the most recent task started by run_async
+    std::shared_future<void> last_task;
+
+    /// guards last_task
+    std::mutex task_lock;
+
+    /// directory for cached results (empty if results are not cached)
+    std::string cache_dir;
+
+    /// description of each call that produced the current list of strings (hashed to name cache files)
+    std::string cache_log;
+
+    /// calls that have been recorded in cache_log but not yet carried out
+    std::vector<std::function<void()> > pending_calls;
+
+    /// can the current list of strings be reproduced from cache_log?
+    bool cacheable;
+
+    /// carrying out pending calls?
+    bool replaying;
+
+    /// record a call to be carried out later (or not at all, if its result is cached). returns false if the call should be carried out now
+    bool defer_call(std::string name, double factor, std::vector<std::vector<std::string> > args, std::function<void()> call);
+
+    /// carry out any pending calls
+    void flush_pending_calls();
+
+    /// can a product of these operators (with bra, ket, and left / right operators) be fully contracted? (fermi vacuum)
+    bool is_fully_contractible(std::vector<std::string> ops);
+
+    /// bring a list of strings to normal order, spreading the work over the thread pool
+    void normal_order_strings(std::vector<std::shared_ptr<pq> > &tmp);
+
 
   public:
 
@@ -82,6 +175,43 @@ class pq_helper {
     /// set print level (default zero)
     void set_print_level(int level);
 
+    /// generate fully-contracted terms directly rather than through repeated normal ordering (fermi vacuum only)
+    void set_use_wick_enumerator(bool do_use_wick_enumerator);
+
+    /// set number of threads used when bringing strings to normal order (default one)
+    void set_num_threads(int n);
+
+    /// generate only connected terms in commutators involving t1, t2, and t3 (fermi vacuum only)
+    void set_connected_only(bool do_connected_only);
+
+    /// relabel summation indices canonically so that all equivalent fully-contracted terms are merged (fermi vacuum only; default false)
+    void set_use_canonical_labels(bool do_use_canonical_labels);
+
+    /// assume real orbitals when putting strings in canonical form (only with canonical labels)
+    void set_real_orbitals(bool do_real_orbitals);
+
+    /// simplify and merge strings as they are added (fermi vacuum only; implies canonical labels)
+    void set_incremental_simplify(bool do_incremental_simplify);
+
+    /// collect timings and counters for each phase of the calculation (default false)
+    void set_collect_stats(bool do_collect_stats);
+
+    /// timings and counters collected since the last call to reset_stats
+    pq_stats get_stats();
+
+    /// reset timings and counters
+    void reset_stats();
+
+    /// run a task on a background thread, after any tasks already started on this object. 
+    /// no other functions should be called on this object until the task is done
+    std::shared_future<void> run_async(std::function<void()> task);
+
+    /// wait for all tasks started by run_async to finish
+    void wait();
+
+    /// cache simplified strings in a directory, and reuse them when the same strings are requested again (empty string to turn off)
+    void set_cache_dir(std::string dir);
+
     /// set a string of creation / annihilation operators
     void set_string(std::vector<std::string> in);
 
@@ -121,35 +251,41 @@ class pq_helper {
     /// add new complete string as a product of operators (i.e., {'h(pq)','t1(ai)'} )
     void add_operator_product(double factor, std::vector<std::string> in);
 
-    /// add similarity-transformed operator expansion of an operator
-    void add_st_operator(double factor, std::vector<std::string> targets, std::vector<std::string> ops);
+    /// add similarity-transformed operator expansion of an operator. returns the number of terms skipped because they cannot be fully contracted
+    int add_st_operator(double factor, std::vector<std::string> targets, std::vector<std::string> ops);
 
-    /// add commutator of two operators
-    void add_commutator(double factor, std::vector<std::string> op0,
-                                       std::vector<std::string> op1);
+    /// add commutator of two operators. returns 1 if skipped because it cannot be fully contracted
+    int add_commutator(double factor, std::vector<std::string> op0,
+                                      std::vector<std::string> op1);
 
-    /// add double commutator involving three operators
-    void add_double_commutator(double factor, std::vector<std::string> op0,
-                                              std::vector<std::string> op1,
-                                              std::vector<std::string> op2);
+    /// add double commutator involving three operators. returns 1 if skipped
+    int add_double_commutator(double factor, std::vector<std::string> op0,
+                                             std::vector<std::string> op1,
+                                             std::vector<std::string> op2);
 
-    /// add triple commutator involving four operators
-    void add_triple_commutator(double factor, std::vector<std::string> op0,
-                                              std::vector<std::string> op1,
-                                              std::vector<std::string> op2,
-                                              std::vector<std::string> op3);
+    /// add triple commutator involving four operators. returns 1 if skipped
+    int add_triple_commutator(double factor, std::vector<std::string> op0,
+                                             std::vector<std::string> op1,
+                                             std::vector<std::string> op2,
+                                             std::vector<std::string> op3);
 
-    /// add quadruple commutator involving five operators
-    void add_quadruple_commutator(double factor, std::vector<std::string> op0,
-                                                 std::vector<std::string> op1,
-                                                 std::vector<std::string> op2,
-                                                 std::vector<std::string> op3,
-                                                 std::vector<std::string> op4);
+    /// add quadruple commutator involving five operators. returns 1 if skipped
+    int add_quadruple_commutator(double factor, std::vector<std::string> op0,
+                                                std::vector<std::string> op1,
+                                                std::vector<std::string> op2,
+                                                std::vector<std::string> op3,
+                                                std::vector<std::string> op4);
 
 
     /// cancel terms, if possible
     void simplify();
 
+    /// write the current list of strings to a binary file
+    void save(std::string filename);
+
+    /// read strings from a file written by save, adding them to the current list
+    void load(std::string filename);
+
     /// clear strings
     void clear();
 
@@ -168,6 +304,27 @@ class pq_helper {
     /// print two-body strings
     void print_two_body();
 
+    /// set the numbers of occupied and virtual orbitals assumed when choosing contraction paths
+    void set_dimension_estimates(double n_occ, double n_vir);
+
+    /// optimal contraction path for each fully-contracted string (see pq_codegen.h)
+    std::vector<term_contraction> contraction_paths();
+
+    /// print the optimal contraction path for each fully-contracted string
+    void print_contraction_paths();
+
+    /// python source for a function that evaluates the fully-contracted strings with numpy.einsum (see pq_codegen.h)
+    std::string einsum_function(std::string name, std::vector<std::string> output_labels);
+
+    /// write functions from einsum_function to a python module
+    void write_einsum_module(std::string filename, std::vector<std::string> functions);
+
+    /// c++ source for a function that evaluates the fully-contracted strings with loops and / or matrix products (see pq_codegen.h)
+    std::string cpp_function(std::string name, std::vector<std::string> output_labels, bool use_gemm);
+
+    /// write functions from cpp_function to a c++ source file
+    void write_cpp_module(std::string filename, std::vector<std::string> functions);
+
 };
 
 }
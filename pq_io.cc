@@ -0,0 +1,450 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: pq_io.cc
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+// file format (all integers are 32-bit, in the byte order of the machine that 
+// wrote the file, and every field starts on a 4-byte boundary):
+//
+//     header:   "PDAGGERQ", version, byte-order mark (0x01020304), vacuum (0 = true, 1 = fermi), 
+//               number of labels, number of strings, key (its length and its characters, padded to 4 bytes)
+//     labels:   for each label, its length and its characters (padded to 4 bytes)
+//     strings:  for each string, 
+//                   flags (has_l0, has_r0, has_u0, has_m0, has_s0, has_w0, simplified), sign, 
+//                   factor (64-bit numerator and denominator, or the bits of a double and 0), tensor type (label), symbols, is_dagger, is_dagger_fermi, delta1, delta2,
+//                   tensor, t / u / m / s / left / right amplitudes, is_boson_dagger
+//
+// lists of labels are stored as a count followed by indices into the label table, 
+// lists of lists as a count followed by the lists, and lists of bools as a count 
+// followed by bits packed into words. files are read through a copy in memory, and 
+// every count is checked against the size of the file, so a truncated or corrupt 
+// file is reported as an error rather than read past its end
+
+#include<memory>
+#include<vector>
+#include<string>
+#include<unordered_map>
+#include<fstream>
+#include<cstring>
+#include<cstdio>
+#include<cstdlib>
+#include<cmath>
+#include<climits>
+#include<unistd.h>
+
+#include "pq.h"
+#include "pq_io.h"
+
+namespace pdaggerq {
+
+static const char pq_file_magic[8] = {'P','D','A','G','G','E','R','Q'};
+
+static const unsigned int pq_byte_order = 0x01020304;
+
+/// sets error (if it isn't set already) and returns false
+static bool io_error(std::string message, std::string filename, std::string & error) {
+    if ( error.empty() ) error = message + " (" + filename + ")";
+    return false;
+}
+
+// builds the contents of a file in memory
+class pq_writer {
+
+  private:
+
+    /// label table
+    std::vector<std::string> labels;
+
+    /// position of each label in the label table
+    std::unordered_map<std::string, unsigned int> label_index;
+
+  public:
+
+    /// everything after the header and label table
+    std::vector<unsigned int> body;
+
+    void put(unsigned int value) {
+        body.push_back(value);
+    }
+
+    void put_label(const std::string & me) {
+        auto it = label_index.find(me);
+        if ( it == label_index.end() ) {
+            it = label_index.insert({me, (unsigned int)labels.size()}).first;
+            labels.push_back(me);
+        }
+        put(it->second);
+    }
+
+    template <class T> void put_labels(const std::vector<T> & list) {
+        put((unsigned int)list.size());
+        for (int i = 0; i < (int)list.size(); i++) {
+            put_label(list[i]);
+        }
+    }
+
+    void put_amplitudes(const std::vector<std::vector<label> > & list) {
+        put((unsigned int)list.size());
+        for (int i = 0; i < (int)list.size(); i++) {
+            put_labels(list[i]);
+        }
+    }
+
+    template <class T> void put_bools(const T & list) {
+        put((unsigned int)list.size());
+        for (int i = 0; i < (int)list.size(); i += 32) {
+            unsigned int word = 0;
+            for (int j = i; j < i + 32 && j < (int)list.size(); j++) {
+                if ( list[j] ) word |= 1u << (j - i);
+            }
+            put(word);
+        }
+    }
+
+    void put_int64(long long value) {
+        unsigned int words[2];
+        memcpy(words, &value, sizeof(long long));
+        put(words[0]);
+        put(words[1]);
+    }
+
+    /// length and characters (padded to 4 bytes) of a string
+    static void put_chars(std::vector<unsigned int> & me, const std::string & in) {
+        unsigned int length = (unsigned int)in.size();
+        me.push_back(length);
+        std::vector<unsigned int> chars((length + 3) / 4, 0);
+        memcpy(chars.data(), in.data(), length);
+        me.insert(me.end(), chars.begin(), chars.end());
+    }
+
+    /// header, label table, and body
+    std::vector<unsigned int> file(unsigned int vacuum, unsigned int n_strings, const std::string & key) {
+
+        std::vector<unsigned int> me(2);
+        memcpy(me.data(), pq_file_magic, 8);
+        me.push_back(pq_file_version);
+        me.push_back(pq_byte_order);
+        me.push_back(vacuum);
+        me.push_back((unsigned int)labels.size());
+        me.push_back(n_strings);
+        put_chars(me, key);
+
+        for (int i = 0; i < (int)labels.size(); i++) {
+            put_chars(me, labels[i]);
+        }
+
+        me.insert(me.end(), body.begin(), body.end());
+
+        return me;
+    }
+};
+
+// reads the contents of a file from memory
+class pq_reader {
+
+  private:
+
+    const unsigned int * words;
+
+    size_t n_words;
+
+    size_t position;
+
+  public:
+
+    /// label table
+    std::vector<label> labels;
+
+    /// the first problem found with the file (empty if there were none). once 
+    /// set, every get returns zeros rather than reading past the end of the file
+    std::string error;
+
+    pq_reader(const unsigned int * in, size_t n) {
+        words    = in;
+        n_words  = n;
+        position = 0;
+    }
+
+    /// is the file still ok?
+    bool ok() {
+        return error.empty();
+    }
+
+    /// note the first problem with the file, and stop reading it
+    void fail(std::string message) {
+        if ( error.empty() ) error = message;
+        position = n_words;
+    }
+
+    unsigned int get() {
+        if ( position >= n_words ) {
+            fail("file is truncated");
+            return 0;
+        }
+        return words[position++];
+    }
+
+    /// a count of items that each take at least words_per_item words
+    unsigned int get_count(size_t words_per_item) {
+        unsigned int n = get();
+        if ( n > ( n_words - position ) / words_per_item ) {
+            fail("file is truncated");
+            return 0;
+        }
+        return n;
+    }
+
+    label get_label() {
+        unsigned int index = get();
+        if ( index >= labels.size() ) {
+            fail("invalid label");
+            return label();
+        }
+        return labels[index];
+    }
+
+    void get_labels(std::vector<label> & list) {
+        unsigned int n = get_count(1);
+        for (unsigned int i = 0; i < n; i++) {
+            list.push_back(get_label());
+        }
+    }
+
+    void get_amplitudes(std::vector<std::vector<label> > & list) {
+        unsigned int n = get_count(1);
+        for (unsigned int i = 0; i < n; i++) {
+            std::vector<label> tmp;
+            get_labels(tmp);
+            list.push_back(tmp);
+        }
+    }
+
+    template <class T> void get_bools(T & list, unsigned int max_size = UINT_MAX) {
+        unsigned int n = get();
+        if ( n > max_size ) {
+            fail("too many operators in string");
+            return;
+        }
+        if ( (size_t)n > ( n_words - position ) * 32 ) {
+            fail("file is truncated");
+            return;
+        }
+        unsigned int word = 0;
+        for (unsigned int i = 0; i < n; i++) {
+            if ( i % 32 == 0 ) word = get();
+            list.push_back( (word >> (i % 32)) & 1u );
+        }
+    }
+
+    long long get_int64() {
+        unsigned int me[2];
+        me[0] = get();
+        me[1] = get();
+        long long value;
+        memcpy(&value, me, sizeof(long long));
+        return value;
+    }
+
+    std::string get_chars(unsigned int length) {
+        size_t n = ( (size_t)length + 3 ) / 4;
+        if ( n > n_words - position ) {
+            fail("file is truncated");
+            return "";
+        }
+        std::string me((const char *)(words + position), length);
+        position += n;
+        return me;
+    }
+
+    bool at_end() {
+        return position == n_words;
+    }
+};
+
+bool save_strings(std::string filename, std::string vacuum, std::vector<std::shared_ptr<pq> > &ordered, std::string key, std::string & error) {
+
+    pq_writer writer;
+
+    unsigned int n_strings = 0;
+    for (int i = 0; i < (int)ordered.size(); i++) {
+
+        if ( ordered[i]->skip ) continue;
+        n_strings++;
+
+        std::shared_ptr<StringData> data = ordered[i]->data;
+
+        unsigned int flags = 0;
+        if ( data->has_l0 ) flags |= 1u << 0;
+        if ( data->has_r0 ) flags |= 1u << 1;
+        if ( data->has_u0 ) flags |= 1u << 2;
+        if ( data->has_m0 ) flags |= 1u << 3;
+        if ( data->has_s0 ) flags |= 1u << 4;
+        if ( data->has_w0 ) flags |= 1u << 5;
+        if ( ordered[i]->simplified ) flags |= 1u << 6;
+        writer.put(flags);
+        writer.put((unsigned int)ordered[i]->sign);
+        if ( data->factor.is_exact() ) {
+            writer.put_int64(data->factor.numerator());
+            writer.put_int64(data->factor.denominator());
+        }else {
+            double value = data->factor.value();
+            long long bits;
+            memcpy(&bits, &value, sizeof(bits));
+            writer.put_int64(bits);
+            writer.put_int64(0);
+        }
+        writer.put_label(data->tensor_type);
+
+        writer.put_labels(ordered[i]->symbol);
+        writer.put_bools(ordered[i]->is_dagger);
+        writer.put_bools(ordered[i]->is_dagger_fermi);
+        writer.put_labels(ordered[i]->delta1);
+        writer.put_labels(ordered[i]->delta2);
+
+        writer.put_labels(data->tensor);
+        writer.put_amplitudes(data->t_amplitudes);
+        writer.put_amplitudes(data->u_amplitudes);
+        writer.put_amplitudes(data->m_amplitudes);
+        writer.put_amplitudes(data->s_amplitudes);
+        writer.put_amplitudes(data->left_amplitudes);
+        writer.put_amplitudes(data->right_amplitudes);
+        writer.put_bools(data->is_boson_dagger);
+    }
+
+    std::vector<unsigned int> contents = writer.file(vacuum == "FERMI" ? 1 : 0, n_strings, key);
+
+    // write to a temporary file and rename it, so readers (possibly in other processes) never see a partial file
+    std::string tmp_name = filename + ".tmp." + std::to_string(getpid());
+    std::ofstream out(tmp_name, std::ios::binary);
+    if ( !out.is_open() ) return io_error("could not open file for writing", tmp_name, error);
+    out.write((const char *)contents.data(), contents.size() * sizeof(unsigned int));
+    out.close();
+    if ( !out ) {
+        remove(tmp_name.c_str());
+        return io_error("could not write file", tmp_name, error);
+    }
+    if ( rename(tmp_name.c_str(), filename.c_str()) != 0 ) {
+        remove(tmp_name.c_str());
+        return io_error("could not write file", filename, error);
+    }
+    return true;
+}
+
+bool load_strings(std::string filename, std::string vacuum, pq_pool * pool, std::vector<std::shared_ptr<pq> > &ordered, std::string key, std::string & error) {
+
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    if ( !in.is_open() ) return io_error("could not open file", filename, error);
+
+    std::streamsize size = in.tellg();
+    in.seekg(0, std::ios::beg);
+    if ( size < 0 || size % sizeof(unsigned int) != 0 ) return io_error("invalid file", filename, error);
+
+    std::vector<unsigned int> contents(size / sizeof(unsigned int));
+    if ( !in.read((char *)contents.data(), size) ) return io_error("could not read file", filename, error);
+
+    pq_reader reader(contents.data(), contents.size());
+
+    // header
+    unsigned int magic[2];
+    magic[0] = reader.get();
+    magic[1] = reader.get();
+    if ( memcmp(magic, pq_file_magic, 8) != 0 ) return io_error("not a pdaggerq file", filename, error);
+
+    unsigned int version = reader.get();
+    if ( version != pq_file_version ) {
+        return io_error("unsupported file version " + std::to_string(version), filename, error);
+    }
+    if ( reader.get() != pq_byte_order ) return io_error("file was written with a different byte order", filename, error);
+
+    unsigned int file_vacuum = reader.get();
+    if ( file_vacuum != ( vacuum == "FERMI" ? 1u : 0u ) ) return io_error("file was written with a different vacuum", filename, error);
+
+    // every label takes at least one word. strings are read only until the file runs out
+    unsigned int n_labels  = reader.get_count(1);
+    unsigned int n_strings = reader.get();
+
+    std::string file_key = reader.get_chars(reader.get());
+    if ( !reader.ok() ) return io_error(reader.error, filename, error);
+    if ( !key.empty() && file_key != key ) return io_error("file was saved with a different key", filename, error);
+
+    for (unsigned int i = 0; i < n_labels && reader.ok(); i++) {
+        unsigned int length = reader.get();
+        reader.labels.push_back(label(reader.get_chars(length)));
+    }
+
+    // strings are only added to ordered once the whole file has been read
+    std::vector<std::shared_ptr<pq> > loaded;
+    for (unsigned int i = 0; i < n_strings && reader.ok(); i++) {
+
+        std::shared_ptr<pq> me = pool->get(vacuum);
+        std::shared_ptr<StringData> data = me->data;
+
+        unsigned int flags = reader.get();
+        data->has_l0 = ( flags >> 0 ) & 1u;
+        data->has_r0 = ( flags >> 1 ) & 1u;
+        data->has_u0 = ( flags >> 2 ) & 1u;
+        data->has_m0 = ( flags >> 3 ) & 1u;
+        data->has_s0 = ( flags >> 4 ) & 1u;
+        data->has_w0 = ( flags >> 5 ) & 1u;
+        me->simplified = ( flags >> 6 ) & 1u;
+        me->sign = (int)reader.get();
+        long long numerator   = reader.get_int64();
+        long long denominator = reader.get_int64();
+        if ( denominator == 0 ) {
+            double value;
+            memcpy(&value, &numerator, sizeof(value));
+            if ( !std::isfinite(value) ) return io_error("invalid factor", filename, error);
+            data->factor = rational::from_value(value);
+        }else {
+            if ( denominator < 0 || numerator == LLONG_MIN ) return io_error("invalid factor", filename, error);
+            data->factor = rational(numerator, denominator);
+        }
+        data->tensor_type = reader.get_label().str();
+
+        reader.get_labels(me->symbol);
+        reader.get_bools(me->is_dagger, operator_flags::capacity);
+        reader.get_bools(me->is_dagger_fermi, operator_flags::capacity);
+        reader.get_labels(me->delta1);
+        reader.get_labels(me->delta2);
+
+        reader.get_labels(data->tensor);
+        reader.get_amplitudes(data->t_amplitudes);
+        reader.get_amplitudes(data->u_amplitudes);
+        reader.get_amplitudes(data->m_amplitudes);
+        reader.get_amplitudes(data->s_amplitudes);
+        reader.get_amplitudes(data->left_amplitudes);
+        reader.get_amplitudes(data->right_amplitudes);
+        reader.get_bools(data->is_boson_dagger);
+
+        loaded.push_back(me);
+    }
+
+    if ( !reader.ok() ) return io_error(reader.error, filename, error);
+    if ( !reader.at_end() ) return io_error("unexpected data at end of file", filename, error);
+
+    ordered.insert(ordered.end(), loaded.begin(), loaded.end());
+
+    return true;
+}
+
+}
@@ -0,0 +1,53 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: pq_io.h
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef PQ_IO_H
+#define PQ_IO_H
+
+#include<memory>
+#include<vector>
+#include<string>
+
+#include "pq.h"
+#include "pq_pool.h"
+
+namespace pdaggerq {
+
+/// version of the file format written by save_strings
+const unsigned int pq_file_version = 3;
+
+/// write a list of strings to a binary file (skipped strings are not written), 
+/// along with a key that describes how they were generated. returns false (and 
+/// sets error) if the file could not be written
+bool save_strings(std::string filename, std::string vacuum, std::vector<std::shared_ptr<pq> > &ordered, std::string key, std::string & error);
+
+/// read a list of strings written by save_strings, appending them to ordered. returns 
+/// false (and sets error, leaving ordered unchanged) if the file could not be read, is 
+/// truncated or corrupt, or (for a nonempty key) was saved with a different key
+bool load_strings(std::string filename, std::string vacuum, pq_pool * pool, std::vector<std::shared_ptr<pq> > &ordered, std::string key, std::string & error);
+
+}
+
+#endif
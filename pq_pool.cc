@@ -0,0 +1,256 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: pq_pool.cc
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include<memory>
+#include<vector>
+#include<string>
+#include<mutex>
+#include<atomic>
+#include<new>
+
+#include "pq.h"
+#include "pq_pool.h"
+
+namespace pdaggerq {
+
+// every shared_ptr handed out by the pool has a control block of the same
+// size, so those blocks are recycled through a single free list
+template <class T> struct pq_pool::allocator {
+
+    typedef T value_type;
+
+    pq_pool * pool;
+
+    allocator(pq_pool * in) : pool(in) {}
+
+    template <class U> allocator(const allocator<U> & in) : pool(in.pool) {}
+
+    T * allocate(size_t n) {
+        return (T *)pool->allocate_block(n * sizeof(T));
+    }
+
+    void deallocate(T * p, size_t n) {
+        pool->deallocate_block((void *)p, n * sizeof(T));
+    }
+
+    template <class U> bool operator==(const allocator<U> & in) const { return pool == in.pool; }
+    template <class U> bool operator!=(const allocator<U> & in) const { return pool != in.pool; }
+};
+
+pq_pool::pq_pool() {
+
+    static std::atomic<unsigned long long> next_id(0);
+    id = next_id++;
+
+    block_size = 0;
+    n_in_use   = 0;
+    n_created  = 0;
+    n_peak     = 0;
+
+}
+
+pq_pool::~pq_pool() {
+
+    clear();
+
+    // threads drop their references to these lists the next time they look for lists
+    for (int i = 0; i < (int)all_lists.size(); i++) {
+        all_lists[i]->retired = true;
+    }
+
+}
+
+pq_pool::local_lists & pq_pool::my_lists() {
+
+    // every pool this thread has used. most threads only ever use one or two
+    static thread_local std::vector<std::pair<unsigned long long, std::shared_ptr<local_lists> > > mine;
+    static thread_local unsigned long long last_id = (unsigned long long)-1;
+    static thread_local local_lists * last = nullptr;
+
+    if ( last_id == id ) return *last;
+
+    for (int i = 0; i < (int)mine.size(); i++) {
+        if ( mine[i].first == id ) {
+            last_id = id;
+            last    = mine[i].second.get();
+            return *last;
+        }
+    }
+
+    // forget lists that belong to pools that no longer exist
+    for (int i = (int)mine.size() - 1; i >= 0; i--) {
+        if ( mine[i].second->retired ) mine.erase(mine.begin() + i);
+    }
+
+    std::shared_ptr<local_lists> me(new local_lists());
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        all_lists.push_back(me);
+    }
+    mine.push_back(std::make_pair(id, me));
+
+    last_id = id;
+    last    = me.get();
+    return *last;
+}
+
+std::shared_ptr<pq> pq_pool::get(std::string vacuum_type) {
+
+    local_lists & mine = my_lists();
+
+    // refill from the shared list
+    if ( mine.strings.empty() ) {
+        std::lock_guard<std::mutex> guard(lock);
+        size_t n = free_strings.size() < batch_size ? free_strings.size() : batch_size;
+        mine.strings.insert(mine.strings.end(), free_strings.end() - n, free_strings.end());
+        free_strings.resize(free_strings.size() - n);
+    }
+
+    pq * me = nullptr;
+    if ( !mine.strings.empty() ) {
+        me = mine.strings.back();
+        mine.strings.pop_back();
+    }
+
+    n_created.fetch_add(1, std::memory_order_relaxed);
+    size_t now = n_in_use.fetch_add(1, std::memory_order_relaxed) + 1;
+    size_t peak = n_peak.load(std::memory_order_relaxed);
+    while ( now > peak && !n_peak.compare_exchange_weak(peak, now, std::memory_order_relaxed) ) {}
+
+    if ( me == nullptr ) {
+        me = new pq(vacuum_type);
+    }else {
+        me->reset(vacuum_type);
+    }
+    me->pool = this;
+
+    return std::shared_ptr<pq>(me, [this](pq * in) { release(in); }, allocator<pq>(this));
+}
+
+void pq_pool::release(pq * in) {
+
+    local_lists & mine = my_lists();
+
+    mine.strings.push_back(in);
+    n_in_use.fetch_sub(1, std::memory_order_relaxed);
+
+    // hand extra strings to other threads
+    if ( mine.strings.size() > 2 * batch_size ) {
+        std::lock_guard<std::mutex> guard(lock);
+        free_strings.insert(free_strings.end(), mine.strings.end() - batch_size, mine.strings.end());
+        mine.strings.resize(mine.strings.size() - batch_size);
+    }
+
+}
+
+void * pq_pool::allocate_block(size_t size) {
+
+    // every control block has the same size, which is set by the first one
+    size_t expected = 0;
+    block_size.compare_exchange_strong(expected, size);
+    if ( size != block_size ) return ::operator new(size);
+
+    local_lists & mine = my_lists();
+
+    if ( mine.blocks.empty() ) {
+        std::lock_guard<std::mutex> guard(lock);
+        size_t n = free_blocks.size() < batch_size ? free_blocks.size() : batch_size;
+        mine.blocks.insert(mine.blocks.end(), free_blocks.end() - n, free_blocks.end());
+        free_blocks.resize(free_blocks.size() - n);
+    }
+
+    if ( !mine.blocks.empty() ) {
+        void * block = mine.blocks.back();
+        mine.blocks.pop_back();
+        return block;
+    }
+
+    return ::operator new(size);
+}
+
+void pq_pool::deallocate_block(void * block, size_t size) {
+
+    if ( size != block_size ) {
+        ::operator delete(block);
+        return;
+    }
+
+    local_lists & mine = my_lists();
+
+    mine.blocks.push_back(block);
+
+    if ( mine.blocks.size() > 2 * batch_size ) {
+        std::lock_guard<std::mutex> guard(lock);
+        free_blocks.insert(free_blocks.end(), mine.blocks.end() - batch_size, mine.blocks.end());
+        mine.blocks.resize(mine.blocks.size() - batch_size);
+    }
+}
+
+void pq_pool::clear() {
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    // merge each thread's lists into the shared ones
+    for (int i = 0; i < (int)all_lists.size(); i++) {
+        local_lists & lists = *all_lists[i];
+        free_strings.insert(free_strings.end(), lists.strings.begin(), lists.strings.end());
+        free_blocks.insert(free_blocks.end(), lists.blocks.begin(), lists.blocks.end());
+        lists.strings.clear();
+        lists.strings.shrink_to_fit();
+        lists.blocks.clear();
+        lists.blocks.shrink_to_fit();
+    }
+
+    for (int i = 0; i < (int)free_strings.size(); i++) {
+        delete free_strings[i];
+    }
+    free_strings.clear();
+    free_strings.shrink_to_fit();
+
+    for (int i = 0; i < (int)free_blocks.size(); i++) {
+        ::operator delete(free_blocks[i]);
+    }
+    free_blocks.clear();
+    free_blocks.shrink_to_fit();
+
+}
+
+size_t pq_pool::in_use() {
+    return n_in_use;
+}
+
+size_t pq_pool::created() {
+    return n_created;
+}
+
+size_t pq_pool::peak() {
+    return n_peak;
+}
+
+void pq_pool::reset_counters() {
+    n_created = 0;
+    n_peak    = n_in_use.load();
+}
+
+}
@@ -0,0 +1,140 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: pq_pool.h
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef PQ_POOL_H
+#define PQ_POOL_H
+
+#include<memory>
+#include<vector>
+#include<string>
+#include<mutex>
+#include<atomic>
+
+namespace pdaggerq {
+
+class pq;
+
+/// a pool of strings. strings handed out by the pool are returned to it
+/// (rather than deleted) when their last shared_ptr goes away, so their
+/// StringData and vector storage can be reused by the next string. the
+/// pool must outlive every string it hands out.
+///
+/// each thread gets and returns strings through its own free lists, so 
+/// threads don't wait on one another. strings only move between threads 
+/// (in batches, through a shared list) when a thread runs out or has too many
+class pq_pool {
+
+  private:
+
+    /// free strings and control blocks that belong to one thread
+    struct local_lists {
+
+        /// strings that are not currently in use
+        std::vector<pq *> strings;
+
+        /// unused blocks of memory for shared_ptr control blocks
+        std::vector<void *> blocks;
+
+        /// set once the pool is destroyed, so threads can forget these lists
+        std::atomic<bool> retired{false};
+
+    };
+
+    /// number of strings / blocks moved between a thread's lists and the shared lists at once
+    static const size_t batch_size = 256;
+
+    /// identifies this pool in each thread's table of lists (never reused, unlike the address)
+    unsigned long long id;
+
+    /// the lists of every thread that has used this pool
+    std::vector<std::shared_ptr<local_lists> > all_lists;
+
+    /// strings that are not currently in use, shared by all threads
+    std::vector<pq *> free_strings;
+
+    /// unused blocks of memory for shared_ptr control blocks, shared by all threads
+    std::vector<void *> free_blocks;
+
+    /// size of the blocks in free_blocks
+    std::atomic<size_t> block_size;
+
+    /// number of strings handed out and not yet returned
+    std::atomic<size_t> n_in_use;
+
+    /// number of strings handed out since the counters were last reset
+    std::atomic<size_t> n_created;
+
+    /// largest value of n_in_use since the counters were last reset
+    std::atomic<size_t> n_peak;
+
+    /// guards all_lists and the shared free lists
+    std::mutex lock;
+
+    /// the calling thread's lists
+    local_lists & my_lists();
+
+    /// return a string to the pool
+    void release(pq * in);
+
+    /// memory for a shared_ptr control block
+    void * allocate_block(size_t size);
+
+    /// return memory for a shared_ptr control block to the pool
+    void deallocate_block(void * block, size_t size);
+
+    /// hands memory for shared_ptr control blocks out of the pool
+    template <class T> struct allocator;
+
+  public:
+
+    /// constructor
+    pq_pool();
+
+    /// destructor
+    ~pq_pool();
+
+    /// get an empty string
+    std::shared_ptr<pq> get(std::string vacuum_type);
+
+    /// free all strings that are not in use, including those held by each thread. 
+    /// no other thread may be getting or returning strings at the time
+    void clear();
+
+    /// number of strings handed out and not yet returned
+    size_t in_use();
+
+    /// number of strings handed out since the counters were last reset
+    size_t created();
+
+    /// largest number of strings in use at once since the counters were last reset
+    size_t peak();
+
+    /// reset created() and peak()
+    void reset_counters();
+
+};
+
+}
+
+#endif
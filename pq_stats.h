@@ -0,0 +1,116 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: pq_stats.h
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef PQ_STATS_H
+#define PQ_STATS_H
+
+#include<vector>
+#include<chrono>
+
+namespace pdaggerq {
+
+/// timings and counters collected by pq_helper (only if requested)
+struct pq_stats {
+
+    /// wall time (s) spent expanding operator products into strings
+    double expand_time       = 0.0;
+
+    /// wall time (s) spent bringing strings to normal order (or enumerating contractions)
+    double normal_order_time = 0.0;
+
+    /// wall time (s) spent applying delta functions
+    double gobble_deltas_time = 0.0;
+
+    /// wall time (s) spent replacing internal labels with conventional ones
+    double relabel_time      = 0.0;
+
+    /// wall time (s) spent alphabetizing strings and cancelling terms
+    double cleanup_time      = 0.0;
+
+    /// number of strings produced by each normal-ordering pass
+    std::vector<long int> created_per_pass;
+
+    /// number of strings dropped by each normal-ordering pass because they can't be fully contracted
+    std::vector<long int> pruned_per_pass;
+
+    /// number of calls to compare_strings during cleanup
+    long int compare_calls   = 0;
+
+    /// number of strings created (filled in by pq_helper::get_stats)
+    long int strings_created = 0;
+
+    /// largest number of strings alive at once (filled in by pq_helper::get_stats)
+    long int peak_strings    = 0;
+
+    /// reset all timings and counters
+    void clear() {
+        expand_time        = 0.0;
+        normal_order_time  = 0.0;
+        gobble_deltas_time = 0.0;
+        relabel_time       = 0.0;
+        cleanup_time       = 0.0;
+        created_per_pass.clear();
+        pruned_per_pass.clear();
+        compare_calls      = 0;
+        strings_created    = 0;
+        peak_strings       = 0;
+    }
+
+    /// add counts for one normal-ordering pass
+    void add_pass(int pass, long int n_created, long int n_pruned) {
+        if ( pass >= (int)created_per_pass.size() ) {
+            created_per_pass.resize(pass + 1, 0);
+            pruned_per_pass.resize(pass + 1, 0);
+        }
+        created_per_pass[pass] += n_created;
+        pruned_per_pass[pass]  += n_pruned;
+    }
+
+};
+
+/// wall time elapsed since start (s)
+inline double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// adds the wall time between its construction and destruction to a total (unless the total is null)
+struct pq_timer {
+
+    double * total;
+
+    std::chrono::steady_clock::time_point start;
+
+    pq_timer(double * in) : total(in) {
+        if ( total != nullptr ) start = std::chrono::steady_clock::now();
+    }
+
+    ~pq_timer() {
+        if ( total != nullptr ) *total += seconds_since(start);
+    }
+
+};
+
+}
+
+#endif
@@ -0,0 +1,251 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: python_api.cc
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include<memory>
+#include<vector>
+#include<string>
+#include<future>
+#include<chrono>
+
+#include "pq_helper.h"
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+using namespace pybind11::literals;
+
+namespace pdaggerq {
+
+/// handle for a task started on a background thread
+struct pq_task {
+
+    std::shared_future<void> task;
+
+    /// the object the task works on, kept alive as long as the handle is
+    std::shared_ptr<pq_helper> helper;
+
+    /// has the task finished?
+    bool done() {
+        return task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    /// wait for the task to finish
+    void wait() {
+        task.wait();
+    }
+
+};
+
+// start a call to a pq_helper function on a background thread. the arguments 
+// are converted from python objects before the task starts, so the task never 
+// needs the gil. the handle (rather than the task) holds on to the object: the 
+// object keeps its last task, so a task that owned the object could end up 
+// destroying it from the task's own thread
+template <class F> pq_task start_task(std::shared_ptr<pq_helper> self, F f) {
+    pq_task me;
+    me.task   = self->run_async(f);
+    me.helper = self;
+    return me;
+}
+
+// wait for tasks on an object without holding the gil, so other python threads 
+// can run in the meantime
+static void wait_without_gil(pq_helper & self) {
+    py::gil_scoped_release nogil;
+    self.wait();
+}
+
+// the destructor waits for tasks on the object, so it shouldn't hold the gil either
+static void delete_without_gil(pq_helper * self) {
+    if ( PyGILState_Check() ) {
+        py::gil_scoped_release nogil;
+        delete self;
+    }else {
+        delete self;
+    }
+}
+
+// wrap a pq_helper function so that it first waits for any tasks started by the 
+// *_async functions. tasks and the calling thread would otherwise use the same 
+// object at the same time. the gil is released while waiting, but not for the 
+// call itself (functions that may take a long time release it with a call_guard, 
+// in which case it has already been released here)
+template <class R, class... Args> auto after_tasks(R (pq_helper::*f)(Args...)) {
+    return [f](pq_helper & self, Args... args) -> R {
+        if ( PyGILState_Check() ) {
+            wait_without_gil(self);
+        }else {
+            self.wait();
+        }
+        return (self.*f)(std::forward<Args>(args)...);
+    };
+}
+
+void export_pq_helper(py::module& m) {
+
+    py::class_<pq_task>(m, "pq_task")
+        .def("done", &pq_task::done)
+        .def("wait", &pq_task::wait, py::call_guard<py::gil_scoped_release>());
+
+    // functions that may take a long time release the gil, so other python
+    // threads (including those driving other pq_helper objects) can run. all
+    // functions other than the *_async ones wait for tasks on the object to finish
+    py::class_<pdaggerq::pq_helper, std::shared_ptr<pdaggerq::pq_helper> >(m, "pq_helper")
+        .def(py::init([](std::string vacuum) {
+            return std::shared_ptr<pq_helper>(new pq_helper(vacuum), delete_without_gil);
+        }))
+        .def("set_print_level", after_tasks(&pq_helper::set_print_level))
+        .def("set_use_wick_enumerator", after_tasks(&pq_helper::set_use_wick_enumerator))
+        .def("set_num_threads", after_tasks(&pq_helper::set_num_threads))
+        .def("set_connected_only", after_tasks(&pq_helper::set_connected_only))
+        .def("set_use_canonical_labels", after_tasks(&pq_helper::set_use_canonical_labels))
+        .def("set_real_orbitals", after_tasks(&pq_helper::set_real_orbitals))
+        .def("set_incremental_simplify", after_tasks(&pq_helper::set_incremental_simplify))
+        .def("set_collect_stats", after_tasks(&pq_helper::set_collect_stats))
+        .def("set_cache_dir", after_tasks(&pq_helper::set_cache_dir))
+        .def("reset_stats", after_tasks(&pq_helper::reset_stats))
+        .def("get_stats", [](pq_helper & self) {
+            wait_without_gil(self);
+            pq_stats stats = self.get_stats();
+            py::dict times;
+            times["expand"]        = stats.expand_time;
+            times["normal_order"]  = stats.normal_order_time;
+            times["gobble_deltas"] = stats.gobble_deltas_time;
+            times["relabel"]       = stats.relabel_time;
+            times["cleanup"]       = stats.cleanup_time;
+            py::dict me;
+            me["time"]             = times;
+            me["created_per_pass"] = stats.created_per_pass;
+            me["pruned_per_pass"]  = stats.pruned_per_pass;
+            me["strings_created"]  = stats.strings_created;
+            me["peak_strings"]     = stats.peak_strings;
+            me["compare_calls"]    = stats.compare_calls;
+            return me;
+        })
+        .def("set_bra", after_tasks(&pq_helper::set_bra))
+        .def("set_ket", after_tasks(&pq_helper::set_ket))
+        .def("set_string", after_tasks(&pq_helper::set_string))
+        .def("set_tensor", after_tasks(&pq_helper::set_tensor))
+        .def("set_t_amplitudes", after_tasks(&pq_helper::set_t_amplitudes))
+        .def("set_u_amplitudes", after_tasks(&pq_helper::set_u_amplitudes))
+        .def("set_m_amplitudes", after_tasks(&pq_helper::set_m_amplitudes))
+        .def("set_s_amplitudes", after_tasks(&pq_helper::set_s_amplitudes))
+        .def("set_left_amplitudes", after_tasks(&pq_helper::set_left_amplitudes))
+        .def("set_right_amplitudes", after_tasks(&pq_helper::set_right_amplitudes))
+        .def("set_left_operators", after_tasks(&pq_helper::set_left_operators))
+        .def("set_right_operators", after_tasks(&pq_helper::set_right_operators))
+        .def("set_factor", after_tasks(&pq_helper::set_factor))
+        .def("add_new_string", after_tasks(&pq_helper::add_new_string), py::call_guard<py::gil_scoped_release>())
+        .def("add_operator_product", after_tasks(&pq_helper::add_operator_product), py::call_guard<py::gil_scoped_release>())
+        .def("add_st_operator", after_tasks(&pq_helper::add_st_operator), py::call_guard<py::gil_scoped_release>())
+        .def("add_commutator", after_tasks(&pq_helper::add_commutator), py::call_guard<py::gil_scoped_release>())
+        .def("add_double_commutator", after_tasks(&pq_helper::add_double_commutator), py::call_guard<py::gil_scoped_release>())
+        .def("add_triple_commutator", after_tasks(&pq_helper::add_triple_commutator), py::call_guard<py::gil_scoped_release>())
+        .def("add_quadruple_commutator", after_tasks(&pq_helper::add_quadruple_commutator), py::call_guard<py::gil_scoped_release>())
+        .def("simplify", after_tasks(&pq_helper::simplify), py::call_guard<py::gil_scoped_release>())
+        .def("clear", after_tasks(&pq_helper::clear), py::call_guard<py::gil_scoped_release>())
+        .def("save", after_tasks(&pq_helper::save), py::call_guard<py::gil_scoped_release>())
+        .def("load", after_tasks(&pq_helper::load), py::call_guard<py::gil_scoped_release>())
+        .def("print", after_tasks(&pq_helper::print), py::call_guard<py::gil_scoped_release>())
+        .def("fully_contracted_strings", after_tasks(&pq_helper::fully_contracted_strings), py::call_guard<py::gil_scoped_release>())
+        .def("print_fully_contracted", after_tasks(&pq_helper::print_fully_contracted), py::call_guard<py::gil_scoped_release>())
+        .def("print_one_body", after_tasks(&pq_helper::print_one_body), py::call_guard<py::gil_scoped_release>())
+        .def("print_two_body", after_tasks(&pq_helper::print_two_body), py::call_guard<py::gil_scoped_release>())
+        .def("set_dimension_estimates", after_tasks(&pq_helper::set_dimension_estimates))
+        .def("contraction_paths", [](pq_helper & self) {
+            wait_without_gil(self);
+            py::list paths;
+            for (const term_contraction & term : self.contraction_paths()) {
+                py::list steps;
+                for (const contraction_step & step : term.path.steps) {
+                    std::vector<std::string> labels;
+                    for (const label & idx : step.labels) {
+                        labels.push_back(idx.str());
+                    }
+                    py::dict me;
+                    me["left"]   = step.left;
+                    me["right"]  = step.right;
+                    me["labels"] = labels;
+                    me["flops"]  = step.flops;
+                    me["memory"] = step.memory;
+                    steps.append(me);
+                }
+                py::dict me;
+                me["string"] = term.string;
+                me["arrays"] = term.arrays;
+                me["steps"]  = steps;
+                me["tree"]   = term.path.tree;
+                me["flops"]  = term.path.flops;
+                me["memory"] = term.path.memory;
+                paths.append(me);
+            }
+            return paths;
+        })
+        .def("print_contraction_paths", after_tasks(&pq_helper::print_contraction_paths), py::call_guard<py::gil_scoped_release>())
+        .def("einsum_function", after_tasks(&pq_helper::einsum_function), py::arg("name"), py::arg("output_labels") = std::vector<std::string>())
+        .def("write_einsum_module", after_tasks(&pq_helper::write_einsum_module))
+        .def("cpp_function", after_tasks(&pq_helper::cpp_function), py::arg("name"), py::arg("output_labels") = std::vector<std::string>(), py::arg("use_gemm") = true)
+        .def("write_cpp_module", after_tasks(&pq_helper::write_cpp_module))
+        .def("wait", &pq_helper::wait, py::call_guard<py::gil_scoped_release>())
+        .def("add_operator_product_async", [](std::shared_ptr<pq_helper> self, double factor, std::vector<std::string> in) {
+            return start_task(self, [helper = self.get(), factor, in]() { helper->add_operator_product(factor, in); });
+        })
+        .def("add_st_operator_async", [](std::shared_ptr<pq_helper> self, double factor, std::vector<std::string> targets, std::vector<std::string> ops) {
+            return start_task(self, [helper = self.get(), factor, targets, ops]() { helper->add_st_operator(factor, targets, ops); });
+        })
+        .def("add_commutator_async", [](std::shared_ptr<pq_helper> self, double factor, std::vector<std::string> op0,
+                                                                         std::vector<std::string> op1) {
+            return start_task(self, [helper = self.get(), factor, op0, op1]() { helper->add_commutator(factor, op0, op1); });
+        })
+        .def("add_double_commutator_async", [](std::shared_ptr<pq_helper> self, double factor, std::vector<std::string> op0,
+                                                                                std::vector<std::string> op1,
+                                                                                std::vector<std::string> op2) {
+            return start_task(self, [helper = self.get(), factor, op0, op1, op2]() { helper->add_double_commutator(factor, op0, op1, op2); });
+        })
+        .def("add_triple_commutator_async", [](std::shared_ptr<pq_helper> self, double factor, std::vector<std::string> op0,
+                                                                                std::vector<std::string> op1,
+                                                                                std::vector<std::string> op2,
+                                                                                std::vector<std::string> op3) {
+            return start_task(self, [helper = self.get(), factor, op0, op1, op2, op3]() { helper->add_triple_commutator(factor, op0, op1, op2, op3); });
+        })
+        .def("add_quadruple_commutator_async", [](std::shared_ptr<pq_helper> self, double factor, std::vector<std::string> op0,
+                                                                                   std::vector<std::string> op1,
+                                                                                   std::vector<std::string> op2,
+                                                                                   std::vector<std::string> op3,
+                                                                                   std::vector<std::string> op4) {
+            return start_task(self, [helper = self.get(), factor, op0, op1, op2, op3, op4]() { helper->add_quadruple_commutator(factor, op0, op1, op2, op3, op4); });
+        })
+        .def("simplify_async", [](std::shared_ptr<pq_helper> self) {
+            return start_task(self, [helper = self.get()]() { helper->simplify(); });
+        });
+}
+
+PYBIND11_MODULE(pdaggerq, m) {
+    m.doc() = "Python API of pdaggerq: A code for bringing strings of creation / annihilation operators to normal order.";
+    export_pq_helper(m);
+}
+
+}
@@ -0,0 +1,196 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: rational.cc
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include<string>
+#include<cmath>
+#include<cstdio>
+#include<cstdlib>
+#include<climits>
+
+#include "rational.h"
+
+namespace pdaggerq {
+
+/// largest denominator that from_double accepts as exact
+static const long long max_denominator = 1000000;
+
+/// a + b, unless it overflows
+static bool checked_add(long long a, long long b, long long & me) {
+    return !__builtin_add_overflow(a, b, &me) && me != LLONG_MIN;
+}
+
+/// a * b, unless it overflows
+static bool checked_multiply(long long a, long long b, long long & me) {
+    return !__builtin_mul_overflow(a, b, &me) && me != LLONG_MIN;
+}
+
+static long long gcd(long long a, long long b) {
+    if ( a < 0 ) a = -a;
+    if ( b < 0 ) b = -b;
+    while ( b != 0 ) {
+        long long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+rational::rational(long long n, long long d) {
+    num    = n;
+    den    = d;
+    exact  = true;
+    approx = 0.0;
+    reduce();
+}
+
+rational rational::from_value(double value) {
+    rational me;
+    me.exact  = false;
+    me.approx = value;
+    return me;
+}
+
+int rational::sign() const {
+    if ( exact ) return ( num > 0 ) - ( num < 0 );
+    if ( fabs(approx) < 1e-12 ) return 0;
+    return approx > 0.0 ? 1 : -1;
+}
+
+void rational::reduce() {
+
+    if ( den == 0 ) {
+        printf("\n");
+        printf("    error: rational factor with zero denominator\n");
+        printf("\n");
+        exit(1);
+    }
+
+    // -LLONG_MIN doesn't exist
+    if ( num == LLONG_MIN || den == LLONG_MIN ) {
+        printf("\n");
+        printf("    error: overflow in rational factor\n");
+        printf("\n");
+        exit(1);
+    }
+
+    if ( den < 0 ) {
+        num = -num;
+        den = -den;
+    }
+
+    long long g = gcd(num, den);
+    if ( g > 1 ) {
+        num /= g;
+        den /= g;
+    }
+    if ( num == 0 ) den = 1;
+}
+
+rational rational::operator+(const rational & other) const {
+
+    if ( !exact || !other.exact ) return from_value(value() + other.value());
+
+    // a/b + c/d = (a (d/g) + c (b/g)) / (b/g) d, with g = gcd(b,d)
+    long long g = gcd(den, other.den);
+    long long ad, cb, n, d;
+    if ( checked_multiply(num, other.den / g, ad) && checked_multiply(other.num, den / g, cb) 
+      && checked_add(ad, cb, n) && checked_multiply(den / g, other.den, d) ) {
+        return rational(n, d);
+    }
+    return from_value(value() + other.value());
+}
+
+rational rational::operator*(const rational & other) const {
+
+    if ( !exact || !other.exact ) return from_value(value() * other.value());
+
+    // cancel common factors first to keep intermediates small
+    long long g1 = gcd(num, other.den);
+    long long g2 = gcd(other.num, den);
+    if ( g1 == 0 ) g1 = 1;
+    if ( g2 == 0 ) g2 = 1;
+    long long n, d;
+    if ( checked_multiply(num / g1, other.num / g2, n) && checked_multiply(den / g2, other.den / g1, d) ) {
+        return rational(n, d);
+    }
+    return from_value(value() * other.value());
+}
+
+rational rational::operator/(const rational & other) const {
+    if ( !exact || !other.exact ) return from_value(value() / other.value());
+    return *this * rational(other.den, other.num);
+}
+
+rational rational::from_double(double value) {
+
+    if ( !std::isfinite(value) ) {
+        printf("\n");
+        printf("    error: invalid factor (%f)\n",value);
+        printf("\n");
+        exit(1);
+    }
+
+    // continued-fraction convergents, stopping at the first one that 
+    // reproduces value to (nearly) double precision. only small denominators
+    // count, so that, e.g., 1/sqrt(2) isn't replaced by a large convergent
+    double x = fabs(value);
+    long long n0 = 0, d0 = 1;
+    long long n1 = 1, d1 = 0;
+    for (int iter = 0; iter < 64; iter++) {
+
+        double a_double = floor(x);
+        if ( a_double > 1e15 ) break;
+        long long a = (long long)a_double;
+
+        long long an, ad, n2, d2;
+        if ( !checked_multiply(a, n1, an) || !checked_add(an, n0, n2) ) break;
+        if ( !checked_multiply(a, d1, ad) || !checked_add(ad, d0, d2) ) break;
+        if ( d2 > max_denominator ) break;
+        n0 = n1; d0 = d1;
+        n1 = n2; d1 = d2;
+
+        if ( fabs((double)n1 / (double)d1 - fabs(value)) <= 1e-14 * fabs(value) ) {
+            return rational(value < 0.0 ? -n1 : n1, d1);
+        }
+
+        double remainder = x - a_double;
+        if ( remainder <= 0.0 ) break;
+        x = 1.0 / remainder;
+    }
+
+    return from_value(value);
+}
+
+std::string rational::str() const {
+    if ( !exact ) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.17g", approx);
+        return buffer;
+    }
+    if ( den == 1 ) return std::to_string(num);
+    return std::to_string(num) + "/" + std::to_string(den);
+}
+
+}
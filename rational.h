@@ -0,0 +1,112 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: rational.h
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef RATIONAL_H
+#define RATIONAL_H
+
+#include<string>
+
+namespace pdaggerq {
+
+/// an exact rational number, num / den, with den > 0 and no common factors. 
+/// factors that aren't ratios of small integers (e.g., 1/sqrt(2)), and results 
+/// of arithmetic that would overflow a 64-bit integer, are kept as doubles instead
+class rational {
+
+  private:
+
+    /// numerator
+    long long num;
+
+    /// denominator
+    long long den;
+
+    /// is the value num / den? (otherwise it is approx)
+    bool exact;
+
+    /// the value, if it is not exact
+    double approx;
+
+    /// divide out common factors and make the denominator positive
+    void reduce();
+
+  public:
+
+    /// constructor (an integer, or num / den)
+    rational(long long n = 0, long long d = 1);
+
+    /// closest rational with a small denominator (e.g., 1.0/24.0 -> 1/24). values 
+    /// that can't be represented this way are kept as doubles. nan and inf are an error
+    static rational from_double(double value);
+
+    /// an inexact value (no attempt to find an equivalent rational)
+    static rational from_value(double value);
+
+    /// is the value an exact ratio of integers?
+    bool is_exact() const { return exact; }
+
+    /// numerator (exact values only)
+    long long numerator() const { return num; }
+
+    /// denominator (exact values only)
+    long long denominator() const { return den; }
+
+    /// value as a double
+    double value() const { return exact ? (double)num / (double)den : approx; }
+
+    /// -1, 0, or 1 (inexact values within 1e-12 of zero count as zero)
+    int sign() const;
+
+    /// absolute value
+    rational abs() const { return sign() < 0 ? -*this : *this; }
+
+    /// num/den (or just num, if den is 1), or the value of an inexact factor
+    std::string str() const;
+
+    rational operator-() const { return exact ? rational(-num, den) : from_value(-approx); }
+
+    rational operator+(const rational & other) const;
+    rational operator-(const rational & other) const { return *this + (-other); }
+    rational operator*(const rational & other) const;
+    rational operator/(const rational & other) const;
+
+    rational & operator+=(const rational & other) { return *this = *this + other; }
+    rational & operator-=(const rational & other) { return *this = *this - other; }
+    rational & operator*=(const rational & other) { return *this = *this * other; }
+    rational & operator/=(const rational & other) { return *this = *this / other; }
+
+    /// exact rationals are always reduced, so equal values have equal numerators and 
+    /// denominators. inexact values are equal if they differ by less than 1e-12
+    bool operator==(const rational & other) const { 
+        if ( exact && other.exact ) return num == other.num && den == other.den;
+        return ( *this - other ).sign() == 0;
+    }
+    bool operator!=(const rational & other) const { return !( *this == other ); }
+
+};
+
+}
+
+#endif
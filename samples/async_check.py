@@ -0,0 +1,92 @@
+
+"""
+checks that the *_async functions can be mixed with ordinary calls on the
+same pq_helper: the ccsd energy, singles, and doubles equations are derived
+once with ordinary calls and once with the strings added (and simplified) on
+background threads, with set_left_operators, fully_contracted_strings, and
+clear called while tasks are still queued. it also checks that another python
+thread keeps running while set_print_level and get_stats wait for a task,
+and that a task handle keeps its pq_helper alive. exits with a nonzero status
+if the equations differ or the other thread was blocked.
+
+    python async_check.py
+"""
+
+import sys
+import time
+import threading
+sys.path.insert(0, './..')
+
+import pdaggerq
+
+projections = [['1'], ['e1(m,e)'], ['e2(m,n,f,e)']]
+
+def derive(use_async):
+    pq = pdaggerq.pq_helper("fermi")
+    pq.set_print_level(0)
+    equations = []
+    for left in projections:
+        pq.set_left_operators([left])
+        for op in ['f', 'v']:
+            if use_async:
+                pq.add_st_operator_async(1.0, [op], ['t1', 't2'])
+            else:
+                pq.add_st_operator(1.0, [op], ['t1', 't2'])
+        if use_async:
+            pq.simplify_async()
+        else:
+            pq.simplify()
+        # these wait for any tasks that are still running
+        equations.append(pq.fully_contracted_strings())
+        pq.clear()
+    return equations
+
+reference = derive(False)
+mixed     = derive(True)
+
+n_bad = 0
+for left, a, b in zip(projections, reference, mixed):
+    same = ( a == b )
+    if not same:
+        n_bad += 1
+    print('    %-16s %4d terms %4d terms  %s' % (left[0], len(a), len(b), 'ok' if same else 'DIFFERENT'))
+
+# count ticks on another thread while ordinary calls wait for a task
+def ticks_while_waiting(call):
+    pq = pdaggerq.pq_helper("fermi")
+    pq.set_print_level(0)
+    pq.set_left_operators([['e2(m,n,f,e)']])
+    task = pq.add_st_operator_async(1.0, ['v'], ['t1', 't2', 't3'])
+    ticks = [0]
+    running = [True]
+    def tick():
+        while running[0]:
+            ticks[0] += 1
+            time.sleep(0.001)
+    ticker = threading.Thread(target=tick)
+    ticker.start()
+    time.sleep(0.01)
+    before = ticks[0]
+    start = time.perf_counter()
+    call(pq)
+    waited = time.perf_counter() - start
+    after = ticks[0]
+    running[0] = False
+    ticker.join()
+    # a handle outlives its pq_helper
+    del pq
+    task.wait()
+    return waited, after - before
+
+for name, call in [('set_print_level', lambda pq: pq.set_print_level(0)),
+                   ('get_stats',       lambda pq: pq.get_stats())]:
+    waited, ticks = ticks_while_waiting(call)
+    blocked = ( waited > 0.1 and ticks < 10 )
+    if blocked:
+        n_bad += 1
+    print('    %-16s waited %6.2f s, %6d ticks  %s' % (name, waited, ticks, 'BLOCKED' if blocked else 'ok'))
+
+if n_bad > 0:
+    print('')
+    print('    %d check(s) failed' % n_bad)
+    sys.exit(1)
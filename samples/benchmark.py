@@ -0,0 +1,321 @@
+
+"""
+benchmarks for pdaggerq, built from the derivations in this directory.
+
+    # run all benchmarks and write the results to results.json
+    python benchmark.py run --output results.json
+
+    # run a subset of the benchmarks
+    python benchmark.py run --output results.json ccsd_energy ccsd_doubles
+
+    # list the available benchmarks
+    python benchmark.py list
+
+    # compare two sets of results (e.g., from two builds). exits with a
+    # nonzero status if anything got slower / larger by more than 10% or
+    # if any term counts changed
+    python benchmark.py compare old.json new.json --threshold 0.10
+
+times cover the calls that derive each equation and simplify(), but not
+counting the terms. with --incremental, strings are merged as they are
+added, so the number of terms before simplify() is not reported.
+
+each benchmark runs in a fresh process so that its peak resident set size
+is not polluted by earlier benchmarks. the module to benchmark is the one
+found first on sys.path (by default, the one in the directory above this
+one, like the other samples); use --path to point somewhere else.
+"""
+
+import sys
+import os
+import json
+import time
+import argparse
+import platform
+import subprocess
+import resource
+
+# derivations, ordered roughly by cost. each one is a list of equations, and
+# each equation is a list of calls to make on a pq_helper before simplify()
+
+def cc_equation(t_ops, rank):
+    # projections onto the reference, singles, doubles, and triples, as in ccsd.py / ccsdt.py
+    left = [['1'], ['e1(m,e)'], ['e2(m,n,f,e)'], ['e3(m,n,o,g,f,e)']]
+    return [[('set_left_operators', [left[rank]]),
+             ('add_st_operator', [1.0, ['f'], t_ops]),
+             ('add_st_operator', [1.0, ['v'], t_ops])]]
+
+def lambda_equation(excitation):
+    return [[('set_left_operators', [['1']]),
+             ('set_right_operators', [['1']]),
+             ('add_st_operator', [1.0, ['f', excitation], ['t1', 't2']]),
+             ('add_st_operator', [1.0, ['v', excitation], ['t1', 't2']]),
+             ('set_left_operators', [['l1', 'l2']]),
+             ('add_st_operator', [ 1.0, ['f', excitation], ['t1', 't2']]),
+             ('add_st_operator', [ 1.0, ['v', excitation], ['t1', 't2']]),
+             ('add_st_operator', [-1.0, [excitation, 'f'], ['t1', 't2']]),
+             ('add_st_operator', [-1.0, [excitation, 'v'], ['t1', 't2']])]]
+
+def eom_ccsd_d1():
+    equations = []
+    for op in ['e1(m,n)', 'e1(e,f)', 'e1(m,e)', 'e1(e,m)']:
+        equations.append([('set_bra', ['vacuum']),
+                          ('set_left_operators', [['l0', 'l1', 'l2']]),
+                          ('set_right_operators', [['r0', 'r1', 'r2']]),
+                          ('add_st_operator', [1.0, [op], ['t1', 't2']])])
+    return equations
+
+def cid_rdm(ops):
+    equations = []
+    for op in ops:
+        equations.append([('set_bra', ['vacuum']),
+                          ('set_left_operators', [['l0', 'l2']]),
+                          ('set_right_operators', [['r0', 'r2']]),
+                          ('add_operator_product', [1.0, [op]])])
+    return equations
+
+benchmarks = [
+    ('cid_d1',          lambda: cid_rdm(['e1(m,n)', 'e1(e,f)', 'e1(m,e)'])),
+    ('cid_d2',          lambda: cid_rdm(['e2(i,j,k,l)', 'e2(a,b,d,c)', 'e2(i,j,b,a)',
+                                         'e2(a,b,j,i)', 'e2(i,a,b,j)', 'e2(i,a,j,b)'])),
+    ('ccsd_energy',     lambda: cc_equation(['t1', 't2'], 0)),
+    ('ccsd_singles',    lambda: cc_equation(['t1', 't2'], 1)),
+    ('ccsd_doubles',    lambda: cc_equation(['t1', 't2'], 2)),
+    ('eom_ccsd_d1',     eom_ccsd_d1),
+    ('lambda_singles',  lambda: lambda_equation('e1(e,m)')),
+    ('lambda_doubles',  lambda: lambda_equation('e2(e,f,n,m)')),
+    ('ccsdt_energy',    lambda: cc_equation(['t1', 't2', 't3'], 0)),
+    ('ccsdt_singles',   lambda: cc_equation(['t1', 't2', 't3'], 1)),
+    ('ccsdt_doubles',   lambda: cc_equation(['t1', 't2', 't3'], 2)),
+    ('ccsdt_triples',   lambda: cc_equation(['t1', 't2', 't3'], 3)),
+]
+
+def configure(pq, options):
+    """ apply optional settings, if this build of pdaggerq supports them """
+    settings = [('set_num_threads', options['threads'], 1),
+                ('set_use_wick_enumerator', options['wick'], False),
+                ('set_connected_only', options['connected'], False),
+                ('set_use_canonical_labels', options['canonical'], False),
+                ('set_real_orbitals', options['real'], False),
+                ('set_incremental_simplify', options['incremental'], False),
+                ('set_collect_stats', options['stats'], False)]
+    for name, value, default in settings:
+        if hasattr(pq, name):
+            getattr(pq, name)(value)
+        elif value != default:
+            raise RuntimeError('this build of pdaggerq does not support %s' % name)
+
+def run_one(name, options):
+    """ run a single benchmark in this process """
+
+    import pdaggerq
+
+    equations = dict(benchmarks)[name]()
+
+    pq = pdaggerq.pq_helper("fermi")
+    pq.set_print_level(0)
+    configure(pq, options)
+
+    result = {'name': name, 'equations': []}
+
+    # only the derivation and simplify() are timed. counting terms means converting
+    # every string to python lists, which would hide changes in the engine itself
+    for equation in equations:
+
+        start = time.perf_counter()
+        for call, args in equation:
+            getattr(pq, call)(*args)
+        wall_time = time.perf_counter() - start
+
+        # with incremental simplification, strings are merged as they are added, so
+        # there is no unsimplified count to report
+        terms_before = None
+        if not options['incremental']:
+            terms_before = len(pq.fully_contracted_strings())
+
+        start = time.perf_counter()
+        pq.simplify()
+        wall_time += time.perf_counter() - start
+
+        terms_after = len(pq.fully_contracted_strings())
+
+        my_eq = {'wall_time': wall_time,
+                 'terms_before_simplify': terms_before,
+                 'terms_after_simplify': terms_after}
+        if options['stats'] and hasattr(pq, 'get_stats'):
+            my_eq['stats'] = pq.get_stats()
+            pq.reset_stats()
+        result['equations'].append(my_eq)
+
+        pq.clear()
+
+    result['wall_time'] = sum(eq['wall_time'] for eq in result['equations'])
+    result['terms_before_simplify'] = None
+    if not options['incremental']:
+        result['terms_before_simplify'] = sum(eq['terms_before_simplify'] for eq in result['equations'])
+    result['terms_after_simplify']  = sum(eq['terms_after_simplify'] for eq in result['equations'])
+
+    # ru_maxrss is in kilobytes on linux and bytes on macos
+    maxrss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    if sys.platform == 'darwin':
+        maxrss //= 1024
+    result['peak_rss_kb'] = maxrss
+
+    return result
+
+def run_all(names, options, repeat):
+    """ run each benchmark in a fresh process, keeping the fastest of several runs """
+
+    results = []
+    for name in names:
+
+        best = None
+        for rep in range(repeat):
+            cmd = [sys.executable, os.path.abspath(__file__), 'child', name,
+                   '--options', json.dumps(options)]
+            output = subprocess.run(cmd, check=True, stdout=subprocess.PIPE,
+                                    universal_newlines=True).stdout
+            me = json.loads(output.strip().splitlines()[-1])
+            if best is None or me['wall_time'] < best['wall_time']:
+                best = me
+
+        before = best['terms_before_simplify']
+        print('    %-16s %10.3f s %10d kB %8s -> %6d terms' % (name, best['wall_time'],
+              best['peak_rss_kb'], '-' if before is None else before, best['terms_after_simplify']))
+        sys.stdout.flush()
+
+        results.append(best)
+
+    return results
+
+def compare(old_file, new_file, threshold, min_time):
+    """ compare two sets of results. returns the number of regressions """
+
+    with open(old_file) as f:
+        old = {me['name']: me for me in json.load(f)['benchmarks']}
+    with open(new_file) as f:
+        new = {me['name']: me for me in json.load(f)['benchmarks']}
+
+    n_regressions = 0
+
+    print('')
+    print('    %-16s %12s %12s %8s %12s %12s %8s  %s' % ('benchmark', 'old time', 'new time', 'ratio',
+          'old rss', 'new rss', 'ratio', 'notes'))
+
+    for name in new:
+
+        if name not in old:
+            print('    %-16s (not in %s)' % (name, old_file))
+            continue
+
+        a = old[name]
+        b = new[name]
+
+        notes = []
+
+        time_ratio = b['wall_time'] / max(a['wall_time'], 1e-12)
+        if time_ratio > 1.0 + threshold and b['wall_time'] - a['wall_time'] > min_time:
+            notes.append('SLOWER')
+
+        rss_ratio = float(b['peak_rss_kb']) / max(a['peak_rss_kb'], 1)
+        if rss_ratio > 1.0 + threshold:
+            notes.append('LARGER')
+
+        # the simplified equations should never change
+        if a['terms_after_simplify'] != b['terms_after_simplify']:
+            notes.append('TERMS %d -> %d' % (a['terms_after_simplify'], b['terms_after_simplify']))
+
+        n_regressions += len(notes)
+
+        print('    %-16s %10.3f s %10.3f s %8.2f %9d kB %9d kB %8.2f  %s' % (name, a['wall_time'],
+              b['wall_time'], time_ratio, a['peak_rss_kb'], b['peak_rss_kb'], rss_ratio, ' '.join(notes)))
+
+    print('')
+    if n_regressions > 0:
+        print('    %d regression(s) found' % n_regressions)
+    else:
+        print('    no regressions found')
+    print('')
+
+    return n_regressions
+
+def main():
+
+    parser = argparse.ArgumentParser(description='pdaggerq benchmarks')
+    sub = parser.add_subparsers(dest='mode')
+
+    run = sub.add_parser('run', help='run benchmarks')
+    run.add_argument('names', nargs='*', help='benchmarks to run (default: all)')
+    run.add_argument('--output', default='benchmark.json', help='file for results (json)')
+    run.add_argument('--repeat', type=int, default=1, help='run each benchmark this many times and keep the fastest')
+    run.add_argument('--max-time', type=float, default=None, help='skip remaining benchmarks once the total time exceeds this (s)')
+    run.add_argument('--threads', type=int, default=1, help='set_num_threads')
+    run.add_argument('--wick', action='store_true', help='set_use_wick_enumerator(True)')
+    run.add_argument('--connected', action='store_true', help='set_connected_only(True)')
+    run.add_argument('--canonical', action='store_true', help='set_use_canonical_labels(True)')
+    run.add_argument('--real', action='store_true', help='set_real_orbitals(True)')
+    run.add_argument('--incremental', action='store_true', help='set_incremental_simplify(True)')
+    run.add_argument('--stats', action='store_true', help='record get_stats() for each equation')
+    run.add_argument('--path', default=None, help='directory containing the pdaggerq module')
+
+    cmp = sub.add_parser('compare', help='compare two sets of results')
+    cmp.add_argument('old')
+    cmp.add_argument('new')
+    cmp.add_argument('--threshold', type=float, default=0.10, help='relative increase in time / memory to flag')
+    cmp.add_argument('--min-time', type=float, default=0.05, help='ignore time differences smaller than this (s)')
+
+    sub.add_parser('list', help='list benchmarks')
+
+    child = sub.add_parser('child')
+    child.add_argument('name')
+    child.add_argument('--options')
+
+    args = parser.parse_args()
+
+    if args.mode == 'list':
+        for name, _ in benchmarks:
+            print(name)
+
+    elif args.mode == 'child':
+        options = json.loads(args.options)
+        sys.path.insert(0, options['path'])
+        print(json.dumps(run_one(args.name, options)))
+
+    elif args.mode == 'run':
+        names = args.names if args.names else [name for name, _ in benchmarks]
+        for name in names:
+            if name not in dict(benchmarks):
+                parser.error('unknown benchmark: %s' % name)
+
+        path = args.path
+        if path is None:
+            path = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+        options = {'threads': args.threads, 'wick': args.wick, 'connected': args.connected,
+                   'canonical': args.canonical, 'real': args.real,
+                   'incremental': args.incremental, 'stats': args.stats, 'path': os.path.abspath(path)}
+
+        print('')
+        results = []
+        total = 0.0
+        for name in names:
+            if args.max_time is not None and total > args.max_time:
+                print('    %-16s (skipped)' % name)
+                continue
+            results += run_all([name], options, args.repeat)
+            total += results[-1]['wall_time']
+        print('')
+
+        with open(args.output, 'w') as f:
+            json.dump({'machine': platform.node(), 'python': platform.python_version(),
+                       'date': time.strftime('%Y-%m-%d %H:%M:%S'), 'options': options,
+                       'benchmarks': results}, f, indent=2)
+
+    elif args.mode == 'compare':
+        if compare(args.old, args.new, args.threshold, args.min_time) > 0:
+            sys.exit(1)
+
+    else:
+        parser.print_help()
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,46 @@
+
+"""
+checks that set_incremental_simplify(True) gives the same equations as
+simplify() with canonical labels, for blocks of the CID two-particle and
+EOM-CCSD one-particle density matrices (cid_d2.py and eom_ccsd_d1.py). exits
+with a nonzero status if any block differs.
+
+    python incremental_check.py
+"""
+
+import sys
+sys.path.insert(0, './..')
+
+import pdaggerq
+
+blocks = []
+for op in ['e2(i,j,k,l)', 'e2(a,b,d,c)', 'e2(i,j,b,a)', 'e2(a,b,j,i)', 'e2(i,a,b,j)', 'e2(i,a,j,b)']:
+    blocks.append(('cid_d2 ' + op, ['l0', 'l2'], ['r0', 'r2'], ('add_operator_product', [1.0, [op]])))
+for op in ['e1(m,n)', 'e1(e,f)', 'e1(m,e)', 'e1(e,m)']:
+    blocks.append(('eom_ccsd_d1 ' + op, ['l0', 'l1', 'l2'], ['r0', 'r1', 'r2'], ('add_st_operator', [1.0, [op], ['t1', 't2']])))
+
+def derive(incremental, left, right, call):
+    pq = pdaggerq.pq_helper("fermi")
+    pq.set_print_level(0)
+    pq.set_use_canonical_labels(True)
+    pq.set_incremental_simplify(incremental)
+    pq.set_bra("vacuum")
+    pq.set_left_operators(left)
+    pq.set_right_operators(right)
+    getattr(pq, call[0])(*call[1])
+    pq.simplify()
+    return pq.fully_contracted_strings()
+
+n_bad = 0
+for name, left, right, call in blocks:
+    reference   = derive(False, left, right, call)
+    incremental = derive(True, left, right, call)
+    same = ( reference == incremental )
+    if not same:
+        n_bad += 1
+    print('    %-28s %4d terms %4d terms  %s' % (name, len(reference), len(incremental), 'ok' if same else 'DIFFERENT'))
+
+if n_bad > 0:
+    print('')
+    print('    %d block(s) differ' % n_bad)
+    sys.exit(1)
@@ -0,0 +1,181 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: tensor_symmetry.cc
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include<vector>
+#include<string>
+#include<map>
+#include<tuple>
+#include<cstdio>
+#include<cstdlib>
+
+#include "tensor_symmetry.h"
+
+namespace pdaggerq {
+
+// a generator of the symmetry group of one kind of tensor
+struct symmetry_rule {
+
+    // tensor type (or AMPLITUDE)
+    std::string tensor_type;
+
+    // number of labels
+    int n_labels;
+
+    // does this symmetry only hold for real orbitals?
+    bool real_only;
+
+    // new position k holds old label order[k]
+    std::vector<int> order;
+
+    // sign of the tensor under this permutation
+    int sign;
+};
+
+// the symmetries of each kind of tensor. anything not listed here is assumed 
+// to have no symmetry. amplitudes are antisymmetric with respect to permutations 
+// of their upper (or lower) labels
+static const std::vector<symmetry_rule> & symmetry_rules() {
+
+    static const std::vector<symmetry_rule> rules = {
+
+        // <pq||rs> = -<qp||rs> = -<pq||sr>, and <pq||rs> = <rs||pq> for real orbitals
+        { "ERI",       4, false, {1, 0, 2, 3}, -1 },
+        { "ERI",       4, false, {0, 1, 3, 2}, -1 },
+        { "ERI",       4, true,  {2, 3, 0, 1},  1 },
+
+        // the general two-body operator, g(pqrs), is not antisymmetrized (no factor 
+        // of 1/4 is applied to it), so it is left without symmetry
+
+        // one-body operators are hermitian, so they are symmetric for real orbitals
+        { "FOCK",      2, true,  {1, 0},  1 },
+        { "CORE",      2, true,  {1, 0},  1 },
+        { "D+",        2, true,  {1, 0},  1 },
+        { "D-",        2, true,  {1, 0},  1 },
+
+        // doubles: t2(a,b,i,j), l2(i,j,a,b), r2, u2, m2, s2
+        { "AMPLITUDE", 4, false, {1, 0, 2, 3}, -1 },
+        { "AMPLITUDE", 4, false, {0, 1, 3, 2}, -1 },
+
+        // triples: t3(a,b,c,i,j,k)
+        { "AMPLITUDE", 6, false, {1, 0, 2, 3, 4, 5}, -1 },
+        { "AMPLITUDE", 6, false, {0, 2, 1, 3, 4, 5}, -1 },
+        { "AMPLITUDE", 6, false, {0, 1, 2, 4, 3, 5}, -1 },
+        { "AMPLITUDE", 6, false, {0, 1, 2, 3, 5, 4}, -1 },
+
+    };
+
+    return rules;
+}
+
+// close the generators under composition
+static std::vector<label_permutation> generate_group(const std::string & tensor_type, int n_labels, bool real_orbitals) {
+
+    std::vector<label_permutation> generators;
+    const std::vector<symmetry_rule> & rules = symmetry_rules();
+    for (int i = 0; i < (int)rules.size(); i++) {
+        if ( rules[i].tensor_type != tensor_type || rules[i].n_labels != n_labels ) continue;
+        if ( rules[i].real_only && !real_orbitals ) continue;
+        generators.push_back({rules[i].order, rules[i].sign});
+    }
+
+    label_permutation identity;
+    identity.sign = 1;
+    for (int k = 0; k < n_labels; k++) {
+        identity.order.push_back(k);
+    }
+
+    std::vector<label_permutation> group(1, identity);
+    std::map<std::vector<int>, int> seen;
+    seen[identity.order] = identity.sign;
+
+    for (int i = 0; i < (int)group.size(); i++) {
+        for (int j = 0; j < (int)generators.size(); j++) {
+
+            // apply generator j after element i
+            label_permutation me;
+            me.sign = group[i].sign * generators[j].sign;
+            for (int k = 0; k < n_labels; k++) {
+                me.order.push_back(group[i].order[generators[j].order[k]]);
+            }
+
+            auto it = seen.find(me.order);
+            if ( it != seen.end() ) {
+                if ( it->second != me.sign ) {
+                    printf("\n");
+                    printf("    error: inconsistent symmetries for tensor type %s\n",tensor_type.c_str());
+                    printf("\n");
+                    exit(1);
+                }
+                continue;
+            }
+            seen[me.order] = me.sign;
+            group.push_back(me);
+        }
+    }
+
+    return group;
+}
+
+const std::vector<label_permutation> & tensor_symmetries(const std::string & tensor_type, int n_labels, bool real_orbitals) {
+
+    // every group is generated once, up front, so lookups are safe from any thread
+    typedef std::tuple<std::string, int, bool> key_type;
+    static const std::map<key_type, std::vector<label_permutation> > groups = [] {
+        std::map<key_type, std::vector<label_permutation> > me;
+        const std::vector<symmetry_rule> & rules = symmetry_rules();
+        for (int i = 0; i < (int)rules.size(); i++) {
+            for (int real = 0; real < 2; real++) {
+                key_type key(rules[i].tensor_type, rules[i].n_labels, real == 1);
+                if ( me.find(key) == me.end() ) {
+                    me[key] = generate_group(rules[i].tensor_type, rules[i].n_labels, real == 1);
+                }
+            }
+        }
+        return me;
+    }();
+
+    auto it = groups.find(key_type(tensor_type, n_labels, real_orbitals));
+    if ( it != groups.end() ) return it->second;
+
+    // no symmetry (just the identity), by number of labels
+    static const std::vector<std::vector<label_permutation> > identities = [] {
+        std::vector<std::vector<label_permutation> > me;
+        for (int n = 0; n <= 16; n++) {
+            me.push_back(generate_group("", n, false));
+        }
+        return me;
+    }();
+
+    if ( n_labels >= (int)identities.size() ) {
+        printf("\n");
+        printf("    error: too many labels in tensor (%i)\n",n_labels);
+        printf("\n");
+        exit(1);
+    }
+
+    return identities[n_labels];
+}
+
+}
@@ -0,0 +1,54 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: tensor_symmetry.h
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef TENSOR_SYMMETRY_H
+#define TENSOR_SYMMETRY_H
+
+#include<vector>
+#include<string>
+
+namespace pdaggerq {
+
+/// a permutation of a tensor's labels (new position k holds old label order[k])
+/// and the sign that the tensor picks up under it
+struct label_permutation {
+
+    /// new position k holds old label order[k]
+    std::vector<int> order;
+
+    /// +1 or -1
+    int sign;
+
+};
+
+/// every permutation of labels that leaves a tensor unchanged up to a sign, including 
+/// the identity. tensor_type is a tensor type (ERI, TWO_BODY, FOCK, ...) or AMPLITUDE 
+/// for t, u, m, s, left-, and right-hand amplitudes. some symmetries hold only for
+/// real orbitals
+const std::vector<label_permutation> & tensor_symmetries(const std::string & tensor_type, int n_labels, bool real_orbitals);
+
+}
+
+#endif
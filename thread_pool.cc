@@ -0,0 +1,143 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: thread_pool.cc
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include<vector>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<functional>
+#include<atomic>
+
+#include "thread_pool.h"
+
+namespace pdaggerq {
+
+thread_pool::thread_pool(int n_workers) {
+
+    n_tasks   = 0;
+    next_task = 0;
+    n_busy    = 0;
+    batch     = 0;
+    stopping  = false;
+
+    for (int i = 0; i < n_workers; i++) {
+        workers.push_back(std::thread(&thread_pool::worker_loop, this));
+    }
+
+}
+
+thread_pool::~thread_pool() {
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    work_ready.notify_all();
+
+    for (int i = 0; i < (int)workers.size(); i++) {
+        workers[i].join();
+    }
+
+}
+
+int thread_pool::size() {
+    return (int)workers.size() + 1;
+}
+
+void thread_pool::do_tasks() {
+
+    for (int i = next_task++; i < n_tasks; i = next_task++) {
+        task(i);
+    }
+
+}
+
+void thread_pool::worker_loop() {
+
+    long int my_batch = 0;
+
+    while ( true ) {
+
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            work_ready.wait(guard, [&] { return stopping || batch != my_batch; });
+            if ( stopping ) return;
+            my_batch = batch;
+        }
+
+        do_tasks();
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            n_busy--;
+            if ( n_busy == 0 ) work_done.notify_one();
+        }
+    }
+
+}
+
+void thread_pool::run(int n, std::function<void(int)> my_task) {
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        task      = my_task;
+        n_tasks   = n;
+        next_task = 0;
+        n_busy    = (int)workers.size();
+        batch++;
+    }
+    work_ready.notify_all();
+
+    // the calling thread works, too
+    do_tasks();
+
+    std::unique_lock<std::mutex> guard(lock);
+    work_done.wait(guard, [&] { return n_busy == 0; });
+
+}
+
+void parallel_for(thread_pool * threads, int n, std::function<void(int)> body) {
+
+    if ( threads == nullptr || n < 2 ) {
+        for (int i = 0; i < n; i++) {
+            body(i);
+        }
+        return;
+    }
+
+    // chunks per thread, so threads that finish early can pick up more work
+    int n_chunks = 8 * threads->size();
+    if ( n_chunks > n ) n_chunks = n;
+
+    threads->run(n_chunks, [&](int c) {
+        int start = (int)( (long int)n * c / n_chunks );
+        int end   = (int)( (long int)n * (c + 1) / n_chunks );
+        for (int i = start; i < end; i++) {
+            body(i);
+        }
+    });
+
+}
+
+}
@@ -0,0 +1,99 @@
+//
+// pdaggerq - A code for bringing strings of creation / annihilation operators to normal order.
+// Filename: thread_pool.h
+// Copyright (C) 2020 A. Eugene DePrince III
+//
+// Author: A. Eugene DePrince III <adeprince@fsu.edu>
+// Maintainer: DePrince group
+//
+// This file is part of the pdaggerq package.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include<vector>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<functional>
+#include<atomic>
+
+namespace pdaggerq {
+
+/// a fixed set of worker threads that stay alive between calls to run()
+class thread_pool {
+
+  private:
+
+    /// worker threads
+    std::vector<std::thread> workers;
+
+    /// guards everything below
+    std::mutex lock;
+
+    /// signals workers that a new batch of tasks is available (or that they should stop)
+    std::condition_variable work_ready;
+
+    /// signals run() that all workers have finished the current batch
+    std::condition_variable work_done;
+
+    /// current batch of tasks
+    std::function<void(int)> task;
+
+    /// number of tasks in current batch
+    int n_tasks;
+
+    /// next task to hand out
+    std::atomic<int> next_task;
+
+    /// number of workers still working on the current batch
+    int n_busy;
+
+    /// incremented for every batch so workers can tell batches apart
+    long int batch;
+
+    /// should workers exit?
+    bool stopping;
+
+    /// take tasks from the current batch until none are left
+    void do_tasks();
+
+    /// what each worker thread does
+    void worker_loop();
+
+  public:
+
+    /// constructor
+    thread_pool(int n_workers);
+
+    /// destructor
+    ~thread_pool();
+
+    /// number of threads that work on a batch (workers plus the calling thread)
+    int size();
+
+    /// call task(0) ... task(n-1), spread over the pool, and wait for all to finish
+    void run(int n, std::function<void(int)> my_task);
+
+};
+
+/// call body(0) ... body(n-1), in contiguous chunks spread over the pool (or serially, if threads is null)
+void parallel_for(thread_pool * threads, int n, std::function<void(int)> body);
+
+}
+
+#endif